@@ -0,0 +1,246 @@
+#include "./GrainBank.h"
+
+static_assert(MultigrainSound::kGuardSamples >= GrainKernels::kSincTaps / 2,
+              "The sinc interpolator reads up to kSincTaps / 2 samples past either end of the sample");
+
+namespace
+{
+    double wrapPosition(double position, double length)
+    {
+        if (position >= length)
+            position -= length;
+
+        if (position < 0.)
+            position += length;
+
+        return position;
+    }
+}
+
+GrainBank::GrainBank(GrainPool& pool)
+    : mPool(pool),
+      mRenderFunction(GrainKernels::getRenderFunction(mInterpolation, mSampleFormat)),
+      mSincTable(GrainKernels::getSincTable())
+{
+}
+
+GrainBank::~GrainBank()
+{
+    deactivateGrains();
+}
+
+void GrainBank::prepare()
+{
+    deactivateGrains();
+
+    if (mCapacity != mPool.getCapacity())
+    {
+        mCapacity = mPool.getCapacity();
+        mActiveGrains.allocate(mCapacity);
+        mGrainsByLevel.allocate(mCapacity);
+        mFinishedGrains.allocate(mCapacity);
+    }
+}
+
+void GrainBank::activateGrain(int startOffset, int durationSamples, GrainPosition position, double pitchRatio,
+                              float grainAmplitude, float pan, GrainWindows::Shape windowShape)
+{
+    if (mCapacity == 0)
+        return;
+
+    const auto grain = mPool.acquireGrain(*this);
+    if (grain < 0)
+        return;
+
+    mPool.mActiveIndex[grain] = mNumActive;
+    mActiveGrains[mNumActive++] = grain;
+
+    // Positions and increment are in samples of level 0, every level halves them
+    const auto length = (double) mSound->length;
+    const auto level = getLevelForPitchRatio(pitchRatio);
+    mPool.mLevel[grain] = level;
+    mPool.mPhaseLeft[grain] = GrainKernels::toPhase(wrapPosition(position.leftPosition, length)) >> level;
+    mPool.mPhaseRight[grain] = GrainKernels::toPhase(wrapPosition(position.rightPosition, length)) >> level;
+    mPool.mPhaseIncrement[grain] = GrainKernels::toPhase(pitchRatio) >> level;
+
+    // Grains that step by whole samples, like the root note of a sample at the playback rate, start on a whole
+    // sample too, then the linear and Hermite interpolators read the samples unchanged
+    if ((mPool.mPhaseIncrement[grain] & 0xffffffffu) == 0)
+    {
+        mPool.mPhaseLeft[grain] &= ~std::uint64_t(0xffffffffu);
+        mPool.mPhaseRight[grain] &= ~std::uint64_t(0xffffffffu);
+    }
+
+    // The window phase covers the whole grain and never overflows before the last sample
+    durationSamples = juce::jmax(2, durationSamples);
+    mPool.mWindowOffset[grain] = GrainWindows::getInstance().getTableOffset(windowShape);
+    mPool.mWindowPhase[grain] = 0;
+    mPool.mWindowIncrement[grain] = (std::uint32_t) ((std::uint64_t(1) << 32) / (std::uint64_t) durationSamples);
+    mPool.mAmplitude[grain] = grainAmplitude;
+
+    // Balance rather than constant power, a centred grain plays both channels at full level
+    mPool.mPanLeft[grain] = juce::jmin(1.f, 1.f - pan);
+    mPool.mPanRight[grain] = juce::jmin(1.f, 1.f + pan);
+
+    mPool.mSamplesRemaining[grain] = durationSamples;
+    mPool.mStartOffset[grain] = startOffset;
+}
+
+void GrainBank::setSound(const MultigrainSound& sound) noexcept
+{
+    jassert(mNumActive == 0 && mNumFinished == 0);
+    mSound = &sound;
+
+    if (sound.getSampleFormat() != mSampleFormat)
+    {
+        mSampleFormat = sound.getSampleFormat();
+        mRenderFunction = GrainKernels::getRenderFunction(mInterpolation, mSampleFormat);
+    }
+}
+
+void GrainBank::setInterpolation(GrainKernels::Interpolation interpolation)
+{
+    if (interpolation != mInterpolation)
+    {
+        mInterpolation = interpolation;
+        mRenderFunction = GrainKernels::getRenderFunction(interpolation, mSampleFormat);
+    }
+}
+
+void GrainBank::renderNextBlock(juce::AudioSampleBuffer& outputBuffer, int startSample, int numSamples)
+{
+    // Also covers a bank that has never been given a sound
+    if (mNumActive == 0)
+        return;
+
+    for (int k = 0; k < mNumActive; k++)
+    {
+        const auto grain = mActiveGrains[k];
+        mPool.mSamplesToProcess[grain] = juce::jmin(numSamples - mPool.mStartOffset[grain], mPool.mSamplesRemaining[grain]);
+    }
+
+    // Grains are rendered in one batch per octave level they read from
+    int levelStart[MultigrainSound::kMaxNumLevels + 1] = {};
+    for (int k = 0; k < mNumActive; k++)
+        levelStart[mPool.mLevel[mActiveGrains[k]] + 1]++;
+
+    for (int level = 0; level < MultigrainSound::kMaxNumLevels; level++)
+        levelStart[level + 1] += levelStart[level];
+
+    int levelEnd[MultigrainSound::kMaxNumLevels];
+    std::copy(levelStart, levelStart + MultigrainSound::kMaxNumLevels, levelEnd);
+    for (int k = 0; k < mNumActive; k++)
+    {
+        const auto grain = mActiveGrains[k];
+        mGrainsByLevel[levelEnd[mPool.mLevel[grain]]++] = grain;
+    }
+
+    GrainRenderContext context {
+        .inL = nullptr,
+        .inR = nullptr,
+        .sincTable = mSincTable,
+        .outL = outputBuffer.getWritePointer (0, startSample),
+        .outR = outputBuffer.getWritePointer (1, startSample),
+        .phaseLength = 0,
+
+        .phaseLeft = mPool.mPhaseLeft.get(),
+        .phaseRight = mPool.mPhaseRight.get(),
+        .phaseIncrement = mPool.mPhaseIncrement.get(),
+
+        .windowTables = GrainWindows::getInstance().getTables(),
+        .windowOffset = mPool.mWindowOffset.get(),
+        .windowPhase = mPool.mWindowPhase.get(),
+        .windowIncrement = mPool.mWindowIncrement.get(),
+        .amplitude = mPool.mAmplitude.get(),
+        .panLeft = mPool.mPanLeft.get(),
+        .panRight = mPool.mPanRight.get(),
+
+        .startOffset = mPool.mStartOffset.get(),
+        .samplesToProcess = mPool.mSamplesToProcess.get()
+    };
+
+    for (int level = 0; level < mSound->getNumLevels(); level++)
+    {
+        const auto numGrains = levelStart[level + 1] - levelStart[level];
+        if (numGrains == 0)
+            continue;
+
+        context.inL = mSound->getReadPointer (0, level);
+        context.inR = mSound->getReadPointer (1, level); // the left channel if a mono sample was provided
+        context.phaseLength = (std::uint64_t) mSound->getLength (level) << 32;
+
+        mRenderFunction(context, mGrainsByLevel.get() + levelStart[level], numGrains);
+    }
+
+    // Compact the active list, finished grains are given back to the pool later on the audio thread
+    auto numStillActive = 0;
+    for (int k = 0; k < mNumActive; k++)
+    {
+        const auto grain = mActiveGrains[k];
+        mPool.mSamplesRemaining[grain] -= mPool.mSamplesToProcess[grain];
+        mPool.mStartOffset[grain] = 0;
+
+        if (mPool.mSamplesRemaining[grain] > 0)
+        {
+            mPool.mActiveIndex[grain] = numStillActive;
+            mActiveGrains[numStillActive++] = grain;
+        }
+        else
+        {
+            mFinishedGrains[mNumFinished++] = grain;
+        }
+    }
+    mNumActive = numStillActive;
+}
+
+void GrainBank::releaseFinishedGrains() noexcept
+{
+    for (int k = 0; k < mNumFinished; k++)
+        mPool.releaseGrain(mFinishedGrains[k]);
+
+    mNumFinished = 0;
+}
+
+void GrainBank::deactivateGrains()
+{
+    releaseFinishedGrains();
+
+    for (int k = 0; k < mNumActive; k++)
+        mPool.releaseGrain(mActiveGrains[k]);
+
+    mNumActive = 0;
+}
+
+void GrainBank::removeGrain(int grain) noexcept
+{
+    const auto index = mPool.mActiveIndex[grain];
+    const auto lastGrain = mActiveGrains[--mNumActive];
+
+    mActiveGrains[index] = lastGrain;
+    mPool.mActiveIndex[lastGrain] = index;
+}
+
+int GrainBank::getLevelForPitchRatio(double pitchRatio) const
+{
+    // Reading level n plays back 2^n times slower, which has to be at most the original speed
+    auto level = 0;
+    while (level + 1 < mSound->getNumLevels() && pitchRatio > 1.0001 * (double) (1 << level))
+        level++;
+
+    return level;
+}
+
+GrainPosition GrainBank::getRelativeGrainPosition(int activeIndex) const
+{
+    const auto grain = mActiveGrains[activeIndex];
+    const auto length = (double) mSound->getLength(mPool.mLevel[grain]);
+    return {
+        .leftPosition = GrainKernels::toSamplePosition(mPool.mPhaseLeft[grain]) / length,
+        .rightPosition = GrainKernels::toSamplePosition(mPool.mPhaseRight[grain]) / length
+    };
+}
+
+float GrainBank::getGrainAmplitude(int activeIndex) const
+{
+    return mPool.getGrainLevel(mActiveGrains[activeIndex]);
+}
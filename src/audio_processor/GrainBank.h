@@ -0,0 +1,91 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+#include "MultigrainSound.h"
+#include "GrainPosition.h"
+#include "GrainKernels.h"
+#include "GrainPool.h"
+#include "GrainWindows.h"
+
+/**
+ * The grains of one voice. Their state lives in the GrainPool shared by all voices,
+ * the bank keeps a compacted list of the grains it owns and renders only those.
+ */
+class GrainBank
+{
+public:
+    explicit GrainBank(GrainPool& pool);
+    ~GrainBank();
+
+    // Allocates an active list that can hold every grain of the pool, must not be called from the audio thread
+    void prepare();
+
+    /**
+     * Starts a grain startOffset samples into the next rendered block, enveloped by windowShape and panned
+     * between -1 (left) and 1 (right). If the grain budget of the pool is used up, the quietest grain of any
+     * voice is replaced.
+     */
+    void activateGrain(int startOffset, int durationSamples, GrainPosition position, double pitchRatio,
+                       float grainAmplitude, float pan, GrainWindows::Shape windowShape);
+
+    // The sound new grains read from and the kernel for its sample format, only call while the bank has no active grains
+    void setSound(const MultigrainSound& sound) noexcept;
+
+    // Selects the kernel used by the following calls to renderNextBlock
+    void setInterpolation(GrainKernels::Interpolation interpolation);
+
+    /**
+     * Adds all active grains to the first two channels of outputBuffer. Only touches grains owned by this bank,
+     * so banks of different voices can render at the same time. Grains that finish are handed back to the pool
+     * by the next call to releaseFinishedGrains.
+     */
+    void renderNextBlock(juce::AudioSampleBuffer& outputBuffer, int startSample, int numSamples);
+
+    // Gives the grains that finished during the last block back to the pool
+    void releaseFinishedGrains() noexcept;
+
+    // Gives all grains back to the pool
+    void deactivateGrains();
+
+    // Level of the voice envelope, weighs the grains of this bank when the pool looks for one to steal
+    void setVoiceLevel(float level) noexcept { mVoiceLevel = level; }
+    float getVoiceLevel() const noexcept { return mVoiceLevel; }
+
+    int getNumActiveGrains() const noexcept { return mNumActive; }
+
+    // Accessors for the nth active grain, used for visualisation
+    GrainPosition getRelativeGrainPosition(int activeIndex) const;
+    float getGrainAmplitude(int activeIndex) const;
+
+private:
+    friend class GrainPool;
+
+    // Called by the pool when it steals one of our grains
+    void removeGrain(int grain) noexcept;
+
+    // Lowest octave level of the sound that can be read at pitchRatio without aliasing
+    int getLevelForPitchRatio(double pitchRatio) const;
+
+    //==========================================================================================
+
+    GrainPool& mPool;
+
+    AlignedArray<int> mActiveGrains;
+    AlignedArray<int> mGrainsByLevel;
+    AlignedArray<int> mFinishedGrains;
+
+    int mNumActive = 0;
+    int mNumFinished = 0;
+    int mCapacity = 0;
+    float mVoiceLevel = 0.f;
+
+    GrainKernels::Interpolation mInterpolation = GrainKernels::Interpolation::linear;
+    GrainKernels::SampleFormat mSampleFormat = GrainKernels::SampleFormat::float32;
+    GrainKernels::RenderFunction mRenderFunction;
+    const float* mSincTable;
+
+    const MultigrainSound* mSound = nullptr;
+
+    JUCE_LEAK_DETECTOR(GrainBank)
+};
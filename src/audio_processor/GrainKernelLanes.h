@@ -0,0 +1,410 @@
+#pragma once
+
+// Only included by the GrainKernels translation units. Everything is kept in an anonymous namespace so that
+// the copies compiled with different instruction sets can never be merged by the linker.
+// The kernels are templated on an interpolator and the sample type so every combination gets its own specialised loop.
+// Lanes::gather has overloads for float and 16 bit samples, the latter widen the integers to float while loading.
+
+#include "GrainKernels.h"
+
+namespace
+{
+    // Number of samples that can be read before phase reaches phaseLength, at most maxSamples
+    inline int getSamplesUntilWrap(std::uint64_t phase, std::uint64_t increment, std::uint64_t phaseLength, int maxSamples)
+    {
+        if (increment == 0)
+            return maxSamples;
+
+        const auto samplesUntilWrap = (phaseLength - phase + increment - 1) / increment;
+        return samplesUntilWrap < (std::uint64_t) maxSamples ? (int) samplesUntilWrap : maxSamples;
+    }
+
+    inline std::uint64_t wrapPhase(std::uint64_t phase, std::uint64_t phaseLength)
+    {
+        return phase >= phaseLength ? phase % phaseLength : phase;
+    }
+
+    // 16 bit samples are read as whole numbers, the gain of a grain scales them back to full scale
+    template <class Sample> constexpr float kSampleScale = 1.f;
+    template <> constexpr float kSampleScale<std::int16_t> = GrainKernels::kInt16Scale;
+
+    // The fraction of a phase as a float in [0, 1), only the top 24 bits fit in the mantissa
+    inline float getFractionAlpha(std::uint32_t fraction)
+    {
+        return (float) (int) (fraction >> 8) * (1.f / 16777216.f);
+    }
+
+    /**
+     * Interpolators read a sample at index + fraction. The scalar read is used by renderGrainsScalar,
+     * the templated read computes one sample per lane for renderGrainLanes.
+     */
+    struct LinearInterpolator
+    {
+        template <class Sample>
+        static float read(const Sample* in, int index, std::uint32_t fraction, const float* /*sincTable*/)
+        {
+            const auto alpha = getFractionAlpha(fraction);
+            const auto x0 = (float) in[index];
+            return x0 + alpha * ((float) in[index + 1] - x0);
+        }
+
+        template <class Lanes, class Sample>
+        static typename Lanes::Float read(const Sample* in, typename Lanes::Int index, typename Lanes::Int fraction, const float* /*sincTable*/)
+        {
+            const auto alpha = Lanes::mul(Lanes::toFloat(Lanes::template shiftRight<8>(fraction)), Lanes::broadcastFloat(1.f / 16777216.f));
+            const auto x0 = Lanes::gather(in, index);
+            const auto x1 = Lanes::gather(in + 1, index);
+            return Lanes::add(x0, Lanes::mul(alpha, Lanes::sub(x1, x0)));
+        }
+    };
+
+    // 4-point, 3rd order Hermite (Catmull-Rom)
+    struct HermiteInterpolator
+    {
+        template <class Sample>
+        static float read(const Sample* in, int index, std::uint32_t fraction, const float* /*sincTable*/)
+        {
+            const auto t = getFractionAlpha(fraction);
+            const auto xm1 = (float) in[index - 1];
+            const auto x0 = (float) in[index];
+            const auto x1 = (float) in[index + 1];
+            const auto x2 = (float) in[index + 2];
+
+            const auto c1 = 0.5f * (x1 - xm1);
+            const auto c2 = xm1 - 2.5f * x0 + 2.f * x1 - 0.5f * x2;
+            const auto c3 = 0.5f * (x2 - xm1) + 1.5f * (x0 - x1);
+            return ((c3 * t + c2) * t + c1) * t + x0;
+        }
+
+        template <class Lanes, class Sample>
+        static typename Lanes::Float read(const Sample* in, typename Lanes::Int index, typename Lanes::Int fraction, const float* /*sincTable*/)
+        {
+            const auto t = Lanes::mul(Lanes::toFloat(Lanes::template shiftRight<8>(fraction)), Lanes::broadcastFloat(1.f / 16777216.f));
+            const auto xm1 = Lanes::gather(in - 1, index);
+            const auto x0 = Lanes::gather(in, index);
+            const auto x1 = Lanes::gather(in + 1, index);
+            const auto x2 = Lanes::gather(in + 2, index);
+
+            const auto half = Lanes::broadcastFloat(0.5f);
+            const auto c1 = Lanes::mul(half, Lanes::sub(x1, xm1));
+            const auto c2 = Lanes::sub(Lanes::add(Lanes::sub(xm1, Lanes::mul(Lanes::broadcastFloat(2.5f), x0)),
+                                                  Lanes::mul(Lanes::broadcastFloat(2.f), x1)),
+                                       Lanes::mul(half, x2));
+            const auto c3 = Lanes::add(Lanes::mul(half, Lanes::sub(x2, xm1)),
+                                       Lanes::mul(Lanes::broadcastFloat(1.5f), Lanes::sub(x0, x1)));
+            return Lanes::add(Lanes::mul(Lanes::add(Lanes::mul(Lanes::add(Lanes::mul(c3, t), c2), t), c1), t), x0);
+        }
+    };
+
+    // Windowed sinc, the coefficients for the nearest of the precomputed fractional phases are used
+    struct SincInterpolator
+    {
+        static constexpr int kFirstTap = 1 - GrainKernels::kSincTaps / 2;
+
+        template <class Sample>
+        static float read(const Sample* in, int index, std::uint32_t fraction, const float* sincTable)
+        {
+            const auto* coefficients = sincTable + (fraction >> (32 - GrainKernels::kSincPhaseBits)) * GrainKernels::kSincTaps;
+            const auto* x = in + index + kFirstTap;
+
+            auto sum = 0.f;
+            for (int tap = 0; tap < GrainKernels::kSincTaps; tap++)
+                sum += (float) x[tap] * coefficients[tap];
+
+            return sum;
+        }
+
+        template <class Lanes, class Sample>
+        static typename Lanes::Float read(const Sample* in, typename Lanes::Int index, typename Lanes::Int fraction, const float* sincTable)
+        {
+            const auto row = Lanes::template shiftLeft<GrainKernels::kSincTapBits>(
+                Lanes::template shiftRight<32 - GrainKernels::kSincPhaseBits>(fraction));
+
+            auto sum = Lanes::mul(Lanes::gather(in + kFirstTap, index), Lanes::gather(sincTable, row));
+            for (int tap = 1; tap < GrainKernels::kSincTaps; tap++)
+                sum = Lanes::add(sum, Lanes::mul(Lanes::gather(in + kFirstTap + tap, index), Lanes::gather(sincTable + tap, row)));
+
+            return sum;
+        }
+    };
+
+    // Adds one grain, scaled by its envelope, to the output of the context
+    template <class Interpolator, class Sample>
+    inline void renderGrain(const GrainRenderContext& c, int grain)
+    {
+        const auto* inL = static_cast<const Sample*>(c.inL);
+        const auto* inR = static_cast<const Sample*>(c.inR);
+        auto* outL = c.outL + c.startOffset[grain];
+        auto* outR = c.outR + c.startOffset[grain];
+        auto numSamples = c.samplesToProcess[grain];
+
+        auto phaseL = c.phaseLeft[grain];
+        auto phaseR = c.phaseRight[grain];
+        const auto phaseIncrement = c.phaseIncrement[grain];
+
+        const auto* window = c.windowTables + c.windowOffset[grain];
+        auto envelopePhase = c.windowPhase[grain];
+        const auto windowIncrement = c.windowIncrement[grain];
+        const auto gainL = c.amplitude[grain] * c.panLeft[grain] * kSampleScale<Sample>;
+        const auto gainR = c.amplitude[grain] * c.panRight[grain] * kSampleScale<Sample>;
+
+        while (numSamples > 0)
+        {
+            // Both read positions stay in front of the guard samples for the whole run
+            const auto furthestPhase = phaseL > phaseR ? phaseL : phaseR;
+            const auto runLength = getSamplesUntilWrap(furthestPhase, phaseIncrement, c.phaseLength, numSamples);
+
+            for (int i = 0; i < runLength; i++)
+            {
+                const auto l = Interpolator::read(inL, (int) (phaseL >> 32), (std::uint32_t) phaseL, c.sincTable);
+                const auto r = Interpolator::read(inR, (int) (phaseR >> 32), (std::uint32_t) phaseR, c.sincTable);
+
+                const auto* table = window + (envelopePhase >> GrainKernels::kWindowIndexShift);
+                const auto tableAlpha = GrainKernels::getWindowFraction(envelopePhase);
+                const auto envelope = table[0] + tableAlpha * (table[1] - table[0]);
+
+                outL[i] += l * (gainL * envelope);
+                outR[i] += r * (gainR * envelope);
+
+                envelopePhase += windowIncrement;
+                phaseL += phaseIncrement;
+                phaseR += phaseIncrement;
+            }
+
+            phaseL = wrapPhase(phaseL, c.phaseLength);
+            phaseR = wrapPhase(phaseR, c.phaseLength);
+
+            outL += runLength;
+            outR += runLength;
+            numSamples -= runLength;
+        }
+
+        c.phaseLeft[grain] = phaseL;
+        c.phaseRight[grain] = phaseR;
+        c.windowPhase[grain] = envelopePhase;
+    }
+
+    // One grain at a time, available on every platform
+    template <class Interpolator, class Sample>
+    void renderGrainsScalar(const GrainRenderContext& context, const int* grains, int numGrains)
+    {
+        for (int k = 0; k < numGrains; k++)
+            renderGrain<Interpolator, Sample>(context, grains[k]);
+    }
+
+    template <class Sample>
+    GrainKernels::RenderFunction getScalarRenderFunction(GrainKernels::Interpolation interpolation)
+    {
+        switch (interpolation)
+        {
+            case GrainKernels::Interpolation::hermite: return renderGrainsScalar<HermiteInterpolator, Sample>;
+            case GrainKernels::Interpolation::sinc: return renderGrainsScalar<SincInterpolator, Sample>;
+            case GrainKernels::Interpolation::linear: break;
+        }
+
+        return renderGrainsScalar<LinearInterpolator, Sample>;
+    }
+
+    inline GrainKernels::RenderFunction getScalarRenderFunction(GrainKernels::Interpolation interpolation, GrainKernels::SampleFormat format)
+    {
+        return format == GrainKernels::SampleFormat::int16 ? getScalarRenderFunction<std::int16_t>(interpolation)
+                                                           : getScalarRenderFunction<float>(interpolation);
+    }
+
+    /**
+     * Renders Lanes::width grains at once, one grain per SIMD lane.
+     * Lanes outside of their [startOffset, startOffset + samplesToProcess) range are masked out,
+     * which lets grains with different onsets and lengths share the same loop. Masked out lanes read the first
+     * sample and the start of their window, so they never read outside of the sample or the window tables.
+     *
+     * The lanes are summed Lanes::width output samples at a time, with one transpose instead of one horizontal
+     * sum per sample.
+     */
+    template <class Lanes, class Interpolator, class Sample>
+    inline void renderGrainLanes(const GrainRenderContext& c, const int* grains)
+    {
+        constexpr int width = Lanes::width;
+        const auto* inL = static_cast<const Sample*>(c.inL);
+        const auto* inR = static_cast<const Sample*>(c.inR);
+
+        alignas(32) std::uint64_t phaseLeft[width], phaseRight[width], phaseIncrement[width];
+        alignas(32) float gainLeft[width], gainRight[width];
+        alignas(32) int windowOffset[width], windowPhase[width], windowIncrement[width], begin[width], end[width];
+
+        auto firstSample = c.startOffset[grains[0]];
+        auto lastSample = 0;
+
+        for (int lane = 0; lane < width; lane++)
+        {
+            const auto grain = grains[lane];
+            phaseLeft[lane] = c.phaseLeft[grain];
+            phaseRight[lane] = c.phaseRight[grain];
+            phaseIncrement[lane] = c.phaseIncrement[grain];
+            gainLeft[lane] = c.amplitude[grain] * c.panLeft[grain] * kSampleScale<Sample>;
+            gainRight[lane] = c.amplitude[grain] * c.panRight[grain] * kSampleScale<Sample>;
+            windowOffset[lane] = c.windowOffset[grain];
+            windowPhase[lane] = (int) c.windowPhase[grain];
+            windowIncrement[lane] = (int) c.windowIncrement[grain];
+            begin[lane] = c.startOffset[grain];
+            end[lane] = c.startOffset[grain] + c.samplesToProcess[grain];
+
+            // no std::min/max here, their out-of-line copies could end up being shared between instruction sets
+            firstSample = begin[lane] < firstSample ? begin[lane] : firstSample;
+            lastSample = end[lane] > lastSample ? end[lane] : lastSample;
+        }
+
+        const auto inc = Lanes::loadPhase(phaseIncrement);
+
+        const auto gainL = Lanes::loadFloat(gainLeft);
+        const auto gainR = Lanes::loadFloat(gainRight);
+        const auto tableOffset = Lanes::loadInt(windowOffset);
+        auto envelopePhase = Lanes::loadInt(windowPhase);
+        const auto envelopeInc = Lanes::loadInt(windowIncrement);
+        const auto laneBegin = Lanes::loadInt(begin);
+        const auto laneEnd = Lanes::loadInt(end);
+
+        const auto fractionMask = Lanes::broadcastInt(0xffff);
+        const auto fractionScale = Lanes::broadcastFloat(1.f / 65536.f);
+
+        typename Lanes::Phase phaseL, phaseR;
+
+        // The contribution of every lane to output sample i
+        auto renderSample = [&] (int i, typename Lanes::Float& productL, typename Lanes::Float& productR)
+        {
+            const auto sampleIndex = Lanes::broadcastInt(i);
+            // begin <= i < end
+            const auto active = Lanes::andNotInt(Lanes::greaterThan(laneBegin, sampleIndex),
+                                                 Lanes::greaterThan(laneEnd, sampleIndex));
+
+            const auto l = Interpolator::template read<Lanes>(inL, Lanes::andInt(Lanes::index(phaseL), active), Lanes::fraction(phaseL), c.sincTable);
+            const auto r = Interpolator::template read<Lanes>(inR, Lanes::andInt(Lanes::index(phaseR), active), Lanes::fraction(phaseR), c.sincTable);
+
+            const auto tableIndex = Lanes::addInt(tableOffset, Lanes::andInt(Lanes::template shiftRight<GrainKernels::kWindowIndexShift>(envelopePhase), active));
+            const auto tableAlpha = Lanes::mul(Lanes::toFloat(Lanes::andInt(Lanes::template shiftRight<GrainKernels::kWindowFractionShift>(envelopePhase), fractionMask)), fractionScale);
+            const auto w0 = Lanes::gather(c.windowTables, tableIndex);
+            const auto w1 = Lanes::gather(c.windowTables + 1, tableIndex);
+            const auto envelope = Lanes::maskFloat(Lanes::add(w0, Lanes::mul(tableAlpha, Lanes::sub(w1, w0))), active);
+
+            productL = Lanes::mul(l, Lanes::mul(gainL, envelope));
+            productR = Lanes::mul(r, Lanes::mul(gainR, envelope));
+
+            // Only active lanes advance
+            envelopePhase = Lanes::addInt(envelopePhase, Lanes::andInt(envelopeInc, active));
+
+            const auto step = Lanes::maskPhase(inc, active);
+            phaseL = Lanes::addPhase(phaseL, step);
+            phaseR = Lanes::addPhase(phaseR, step);
+        };
+
+        // The loop is split into runs in which no lane reads past the end of the sample,
+        // phases only get wrapped in between runs
+        for (int runStart = firstSample; runStart < lastSample;)
+        {
+            auto runEnd = lastSample;
+
+            for (int lane = 0; lane < width; lane++)
+            {
+                const auto laneStart = begin[lane] > runStart ? begin[lane] : runStart;
+                const auto laneSamples = end[lane] - laneStart;
+                if (laneSamples <= 0)
+                    continue;
+
+                const auto furthestPhase = phaseLeft[lane] > phaseRight[lane] ? phaseLeft[lane] : phaseRight[lane];
+                const auto samplesUntilWrap = getSamplesUntilWrap(furthestPhase, phaseIncrement[lane], c.phaseLength, laneSamples);
+
+                if (samplesUntilWrap < laneSamples && laneStart + samplesUntilWrap < runEnd)
+                    runEnd = laneStart + samplesUntilWrap;
+            }
+
+            phaseL = Lanes::loadPhase(phaseLeft);
+            phaseR = Lanes::loadPhase(phaseRight);
+
+            typename Lanes::Float productsL[width], productsR[width];
+            auto i = runStart;
+
+            for (; i + width <= runEnd; i += width)
+            {
+                for (int k = 0; k < width; k++)
+                    renderSample(i + k, productsL[k], productsR[k]);
+
+                Lanes::accumulate(c.outL + i, Lanes::sumEach(productsL));
+                Lanes::accumulate(c.outR + i, Lanes::sumEach(productsR));
+            }
+
+            // The last few samples of the run, the missing ones add nothing
+            if (i < runEnd)
+            {
+                const auto numLeft = runEnd - i;
+                for (int k = 0; k < width; k++)
+                {
+                    if (k < numLeft)
+                        renderSample(i + k, productsL[k], productsR[k]);
+                    else
+                        productsL[k] = productsR[k] = Lanes::broadcastFloat(0.f);
+                }
+
+                alignas(32) float sumsL[width], sumsR[width];
+                Lanes::storeFloat(sumsL, Lanes::sumEach(productsL));
+                Lanes::storeFloat(sumsR, Lanes::sumEach(productsR));
+
+                for (int k = 0; k < numLeft; k++)
+                {
+                    c.outL[i + k] += sumsL[k];
+                    c.outR[i + k] += sumsR[k];
+                }
+            }
+
+            Lanes::storePhase(phaseLeft, phaseL);
+            Lanes::storePhase(phaseRight, phaseR);
+
+            for (int lane = 0; lane < width; lane++)
+            {
+                phaseLeft[lane] = wrapPhase(phaseLeft[lane], c.phaseLength);
+                phaseRight[lane] = wrapPhase(phaseRight[lane], c.phaseLength);
+            }
+
+            runStart = runEnd;
+        }
+
+        Lanes::storeInt(windowPhase, envelopePhase);
+
+        for (int lane = 0; lane < width; lane++)
+        {
+            const auto grain = grains[lane];
+            c.phaseLeft[grain] = phaseLeft[lane];
+            c.phaseRight[grain] = phaseRight[lane];
+            c.windowPhase[grain] = (std::uint32_t) windowPhase[lane];
+        }
+    }
+
+    template <class Lanes, class Interpolator, class Sample>
+    void renderGrainsWithLanes(const GrainRenderContext& context, const int* grains, int numGrains)
+    {
+        auto numGrainsInLanes = numGrains - numGrains % Lanes::width;
+
+        for (int k = 0; k < numGrainsInLanes; k += Lanes::width)
+            renderGrainLanes<Lanes, Interpolator, Sample>(context, grains + k);
+
+        renderGrainsScalar<Interpolator, Sample>(context, grains + numGrainsInLanes, numGrains - numGrainsInLanes);
+    }
+
+    template <class Lanes, class Sample>
+    GrainKernels::RenderFunction getLanesRenderFunction(GrainKernels::Interpolation interpolation)
+    {
+        switch (interpolation)
+        {
+            case GrainKernels::Interpolation::hermite: return renderGrainsWithLanes<Lanes, HermiteInterpolator, Sample>;
+            case GrainKernels::Interpolation::sinc: return renderGrainsWithLanes<Lanes, SincInterpolator, Sample>;
+            case GrainKernels::Interpolation::linear: break;
+        }
+
+        return renderGrainsWithLanes<Lanes, LinearInterpolator, Sample>;
+    }
+
+    template <class Lanes>
+    GrainKernels::RenderFunction getLanesRenderFunction(GrainKernels::Interpolation interpolation, GrainKernels::SampleFormat format)
+    {
+        return format == GrainKernels::SampleFormat::int16 ? getLanesRenderFunction<Lanes, std::int16_t>(interpolation)
+                                                           : getLanesRenderFunction<Lanes, float>(interpolation);
+    }
+}
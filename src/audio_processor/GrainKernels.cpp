@@ -0,0 +1,216 @@
+#include <juce_core/juce_core.h>
+
+#include "./GrainKernelLanes.h"
+
+#if JUCE_INTEL
+ #include <emmintrin.h>
+ #define MULTIGRAIN_SSE2_KERNEL 1
+#elif JUCE_ARM && JUCE_64BIT
+ #include <arm_neon.h>
+ #define MULTIGRAIN_NEON_KERNEL 1
+#endif
+
+namespace
+{
+#if MULTIGRAIN_SSE2_KERNEL
+    // Four grains per register, phases are kept as two pairs of 64 bit integers
+    struct SSE2Lanes
+    {
+        static constexpr int width = 4;
+
+        using Float = __m128;
+        using Int = __m128i;
+        struct Phase { __m128i lo, hi; };
+
+        static Float loadFloat(const float* p) { return _mm_load_ps(p); }
+        static Int loadInt(const int* p) { return _mm_load_si128(reinterpret_cast<const __m128i*>(p)); }
+        static Phase loadPhase(const std::uint64_t* p)
+        {
+            return { _mm_load_si128(reinterpret_cast<const __m128i*>(p)), _mm_load_si128(reinterpret_cast<const __m128i*>(p + 2)) };
+        }
+        static void storeFloat(float* p, Float v) { _mm_store_ps(p, v); }
+        static void storeInt(int* p, Int v) { _mm_store_si128(reinterpret_cast<__m128i*>(p), v); }
+        static void storePhase(std::uint64_t* p, Phase v)
+        {
+            _mm_store_si128(reinterpret_cast<__m128i*>(p), v.lo);
+            _mm_store_si128(reinterpret_cast<__m128i*>(p + 2), v.hi);
+        }
+
+        static Int broadcastInt(int v) { return _mm_set1_epi32(v); }
+        static Float broadcastFloat(float v) { return _mm_set1_ps(v); }
+
+        static Float add(Float a, Float b) { return _mm_add_ps(a, b); }
+        static Float sub(Float a, Float b) { return _mm_sub_ps(a, b); }
+        static Float mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+        static Int addInt(Int a, Int b) { return _mm_add_epi32(a, b); }
+        static Phase addPhase(Phase a, Phase b) { return { _mm_add_epi64(a.lo, b.lo), _mm_add_epi64(a.hi, b.hi) }; }
+
+        static Int greaterThan(Int a, Int b) { return _mm_cmpgt_epi32(a, b); }
+        static Int andInt(Int a, Int b) { return _mm_and_si128(a, b); }
+        static Int andNotInt(Int a, Int b) { return _mm_andnot_si128(a, b); }
+        static Float maskFloat(Float v, Int mask) { return _mm_and_ps(v, _mm_castsi128_ps(mask)); }
+        template <int bits> static Int shiftLeft(Int v) { return _mm_slli_epi32(v, bits); }
+        template <int bits> static Int shiftRight(Int v) { return _mm_srli_epi32(v, bits); }
+        static Float toFloat(Int v) { return _mm_cvtepi32_ps(v); }
+        static Phase maskPhase(Phase v, Int mask)
+        {
+            return { _mm_and_si128(v.lo, _mm_unpacklo_epi32(mask, mask)), _mm_and_si128(v.hi, _mm_unpackhi_epi32(mask, mask)) };
+        }
+
+        // Upper 32 bits of every phase
+        static Int index(Phase v)
+        {
+            return _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(v.lo), _mm_castsi128_ps(v.hi), _MM_SHUFFLE(3, 1, 3, 1)));
+        }
+        // Lower 32 bits of every phase
+        static Int fraction(Phase v)
+        {
+            return _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(v.lo), _mm_castsi128_ps(v.hi), _MM_SHUFFLE(2, 0, 2, 0)));
+        }
+
+        // SSE2 has no gather instruction
+        static Float gather(const float* base, Int index)
+        {
+            alignas(16) int i[width];
+            storeInt(i, index);
+            return _mm_setr_ps(base[i[0]], base[i[1]], base[i[2]], base[i[3]]);
+        }
+        static Float gather(const std::int16_t* base, Int index)
+        {
+            alignas(16) int i[width];
+            storeInt(i, index);
+            return _mm_cvtepi32_ps(_mm_setr_epi32(base[i[0]], base[i[1]], base[i[2]], base[i[3]]));
+        }
+
+        // Lane i of the result is the sum of the lanes of v[i]
+        static Float sumEach(const Float* v)
+        {
+            auto v0 = v[0], v1 = v[1], v2 = v[2], v3 = v[3];
+            _MM_TRANSPOSE4_PS(v0, v1, v2, v3);
+            return _mm_add_ps(_mm_add_ps(v0, v1), _mm_add_ps(v2, v3));
+        }
+        static void accumulate(float* p, Float v) { _mm_storeu_ps(p, _mm_add_ps(_mm_loadu_ps(p), v)); }
+    };
+#endif
+
+#if MULTIGRAIN_NEON_KERNEL
+    // Four grains per register, phases are kept as two pairs of 64 bit integers
+    struct NeonLanes
+    {
+        static constexpr int width = 4;
+
+        using Float = float32x4_t;
+        using Int = int32x4_t;
+        struct Phase { uint64x2_t lo, hi; };
+
+        static Float loadFloat(const float* p) { return vld1q_f32(p); }
+        static Int loadInt(const int* p) { return vld1q_s32(p); }
+        static Phase loadPhase(const std::uint64_t* p) { return { vld1q_u64(p), vld1q_u64(p + 2) }; }
+        static void storeFloat(float* p, Float v) { vst1q_f32(p, v); }
+        static void storeInt(int* p, Int v) { vst1q_s32(p, v); }
+        static void storePhase(std::uint64_t* p, Phase v) { vst1q_u64(p, v.lo); vst1q_u64(p + 2, v.hi); }
+
+        static Int broadcastInt(int v) { return vdupq_n_s32(v); }
+        static Float broadcastFloat(float v) { return vdupq_n_f32(v); }
+
+        static Float add(Float a, Float b) { return vaddq_f32(a, b); }
+        static Float sub(Float a, Float b) { return vsubq_f32(a, b); }
+        static Float mul(Float a, Float b) { return vmulq_f32(a, b); }
+        static Int addInt(Int a, Int b) { return vaddq_s32(a, b); }
+        static Phase addPhase(Phase a, Phase b) { return { vaddq_u64(a.lo, b.lo), vaddq_u64(a.hi, b.hi) }; }
+
+        static Int greaterThan(Int a, Int b) { return vreinterpretq_s32_u32(vcgtq_s32(a, b)); }
+        static Int andInt(Int a, Int b) { return vandq_s32(a, b); }
+        static Int andNotInt(Int a, Int b) { return vbicq_s32(b, a); }
+        static Float maskFloat(Float v, Int mask) { return vreinterpretq_f32_s32(vandq_s32(vreinterpretq_s32_f32(v), mask)); }
+        template <int bits> static Int shiftLeft(Int v) { return vshlq_n_s32(v, bits); }
+        template <int bits> static Int shiftRight(Int v) { return vreinterpretq_s32_u32(vshrq_n_u32(vreinterpretq_u32_s32(v), bits)); }
+        static Float toFloat(Int v) { return vcvtq_f32_s32(v); }
+        static Phase maskPhase(Phase v, Int mask)
+        {
+            return { vandq_u64(v.lo, vreinterpretq_u64_s64(vmovl_s32(vget_low_s32(mask)))),
+                     vandq_u64(v.hi, vreinterpretq_u64_s64(vmovl_s32(vget_high_s32(mask)))) };
+        }
+
+        // Upper 32 bits of every phase
+        static Int index(Phase v) { return vreinterpretq_s32_u32(vcombine_u32(vshrn_n_u64(v.lo, 32), vshrn_n_u64(v.hi, 32))); }
+        // Lower 32 bits of every phase
+        static Int fraction(Phase v) { return vreinterpretq_s32_u32(vcombine_u32(vmovn_u64(v.lo), vmovn_u64(v.hi))); }
+
+        static Float gather(const float* base, Int index)
+        {
+            auto v = vdupq_n_f32(base[vgetq_lane_s32(index, 0)]);
+            v = vld1q_lane_f32(base + vgetq_lane_s32(index, 1), v, 1);
+            v = vld1q_lane_f32(base + vgetq_lane_s32(index, 2), v, 2);
+            return vld1q_lane_f32(base + vgetq_lane_s32(index, 3), v, 3);
+        }
+        // Widens the four 16 bit samples in one go
+        static Float gather(const std::int16_t* base, Int index)
+        {
+            auto v = vld1_dup_s16(base + vgetq_lane_s32(index, 0));
+            v = vld1_lane_s16(base + vgetq_lane_s32(index, 1), v, 1);
+            v = vld1_lane_s16(base + vgetq_lane_s32(index, 2), v, 2);
+            v = vld1_lane_s16(base + vgetq_lane_s32(index, 3), v, 3);
+            return vcvtq_f32_s32(vmovl_s16(v));
+        }
+
+        // Lane i of the result is the sum of the lanes of v[i]
+        static Float sumEach(const Float* v) { return vpaddq_f32(vpaddq_f32(v[0], v[1]), vpaddq_f32(v[2], v[3])); }
+        static void accumulate(float* p, Float v) { vst1q_f32(p, vaddq_f32(vld1q_f32(p), v)); }
+    };
+#endif
+}
+
+const float* GrainKernels::getSincTable()
+{
+    static const std::vector<float> table = []
+    {
+        constexpr int numPhases = 1 << kSincPhaseBits;
+        const auto pi = juce::MathConstants<double>::pi;
+        std::vector<float> coefficients((size_t) (numPhases * kSincTaps));
+
+        for (int phase = 0; phase < numPhases; phase++)
+        {
+            // A phase stands for all fractions up to the next one, so the coefficients are for its centre
+            const auto fraction = (phase + 0.5) / numPhases;
+            auto* row = coefficients.data() + phase * kSincTaps;
+            auto sum = 0.;
+
+            for (int tap = 0; tap < kSincTaps; tap++)
+            {
+                const auto x = (double) (tap + 1 - kSincTaps / 2) - fraction;
+                const auto sinc = std::abs(x) < 1.0e-9 ? 1. : std::sin(pi * x) / (pi * x);
+                const auto window = 0.42 + 0.5 * std::cos(2. * pi * x / kSincTaps) + 0.08 * std::cos(4. * pi * x / kSincTaps);
+                row[tap] = (float) (sinc * window);
+                sum += row[tap];
+            }
+
+            // Unity gain at DC
+            for (int tap = 0; tap < kSincTaps; tap++)
+                row[tap] = (float) (row[tap] / sum);
+        }
+
+        return coefficients;
+    }();
+
+    return table.data();
+}
+
+GrainKernels::RenderFunction GrainKernels::getRenderFunction(Interpolation interpolation, SampleFormat format)
+{
+#if MULTIGRAIN_AVX2_KERNEL
+    if (juce::SystemStats::hasAVX2())
+        return getAVX2RenderFunction(interpolation, format);
+#endif
+
+#if MULTIGRAIN_SSE2_KERNEL
+    if (juce::SystemStats::hasSSE2())
+        return getLanesRenderFunction<SSE2Lanes>(interpolation, format);
+
+    return getScalarRenderFunction(interpolation, format);
+#elif MULTIGRAIN_NEON_KERNEL
+    return getLanesRenderFunction<NeonLanes>(interpolation, format);
+#else
+    return getScalarRenderFunction(interpolation, format);
+#endif
+}
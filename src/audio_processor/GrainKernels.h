@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Pointers into the structure-of-arrays state of a GrainBank plus the block that is being rendered.
+ * Grains start at startOffset[grain] and render samplesToProcess[grain] samples.
+ *
+ * Read positions are 32.32 fixed-point phases. inL and inR must have a few wrapped guard samples behind
+ * phaseLength so the kernels only have to wrap between runs of samples instead of after every sample.
+ * They point to floats or 16 bit integers, depending on the sample format the render function was made for.
+ *
+ * The envelope of a grain is read from its table in windowTables at a 0.32 fixed-point phase
+ * that runs from the start to the end of the grain. It is scaled by the amplitude of the grain
+ * and by panLeft and panRight for the two output channels.
+ */
+struct GrainRenderContext
+{
+    const void* inL;
+    const void* inR;
+    const float* sincTable;
+    float* outL;
+    float* outR;
+    std::uint64_t phaseLength;
+
+    std::uint64_t* phaseLeft;
+    std::uint64_t* phaseRight;
+    const std::uint64_t* phaseIncrement;
+
+    const float* windowTables;
+    const int* windowOffset;
+    std::uint32_t* windowPhase;
+    const std::uint32_t* windowIncrement;
+    const float* amplitude;
+    const float* panLeft;
+    const float* panRight;
+
+    const int* startOffset;
+    const int* samplesToProcess;
+};
+
+namespace GrainKernels
+{
+    // 32.32 fixed point, the upper half is the sample index and the lower half the fraction in between
+    inline std::uint64_t toPhase(double samplePosition)
+    {
+        return (std::uint64_t) (samplePosition * 4294967296.0);
+    }
+
+    inline double toSamplePosition(std::uint64_t phase)
+    {
+        return (double) phase * (1.0 / 4294967296.0);
+    }
+
+    // The upper bits of a window phase select the table entry, the next 16 bits interpolate in between
+    constexpr int kWindowTableBits = 10;
+    constexpr int kWindowTableSize = 1 << kWindowTableBits;
+    constexpr int kWindowIndexShift = 32 - kWindowTableBits;
+    constexpr int kWindowFractionShift = kWindowIndexShift - 16;
+
+    inline float getWindowFraction(std::uint32_t windowPhase)
+    {
+        return (float) (int) ((windowPhase >> kWindowFractionShift) & 0xffff) * (1.f / 65536.f);
+    }
+
+    // Keep in sync with the "Interpolation" parameter choices
+    enum class Interpolation
+    {
+        linear,
+        hermite,
+        sinc
+    };
+
+    constexpr int kNumInterpolations = 3;
+
+    // How the samples of a sound are stored. 16 bit samples are converted to float while they are read
+    enum class SampleFormat
+    {
+        float32,
+        int16
+    };
+
+    // Full scale of a 16 bit sample
+    constexpr float kInt16Scale = 1.f / 32768.f;
+
+    // The sinc interpolator reads kSincTaps samples around the read position, using one of 2^kSincPhaseBits coefficient sets
+    constexpr int kSincTapBits = 3;
+    constexpr int kSincTaps = 1 << kSincTapBits;
+    constexpr int kSincPhaseBits = 10;
+
+    /**
+     * Polyphase windowed sinc coefficients, kSincTaps per fractional phase.
+     * Built on first use, the GrainBank constructor calls this from the message thread.
+     */
+    const float* getSincTable();
+
+    // Renders the grains in the index list grains into the output of context
+    using RenderFunction = void (*)(const GrainRenderContext& context, const int* grains, int numGrains);
+
+    /**
+     * Returns the fastest render function for the interpolation and sample format supported by the CPU we are
+     * running on. Wide kernels render several grains at once in SIMD lanes, leftover grains use the scalar kernel.
+     */
+    RenderFunction getRenderFunction(Interpolation interpolation, SampleFormat format);
+
+#if MULTIGRAIN_AVX2_KERNEL
+    // Lives in its own translation unit which is compiled with AVX2 enabled
+    RenderFunction getAVX2RenderFunction(Interpolation interpolation, SampleFormat format);
+#endif
+}
@@ -0,0 +1,96 @@
+// This translation unit is compiled with AVX2 enabled (see CMakeLists.txt). Nothing in here may be called
+// before GrainKernels::getRenderFunction has checked that the CPU supports it, and no JUCE headers are
+// included so that no inline function compiled for AVX2 can leak into the rest of the plugin.
+
+#if MULTIGRAIN_AVX2_KERNEL
+
+#include <immintrin.h>
+
+#include "./GrainKernelLanes.h"
+
+namespace
+{
+    // Eight grains per register, phases are kept as two quads of 64 bit integers
+    struct AVX2Lanes
+    {
+        static constexpr int width = 8;
+
+        using Float = __m256;
+        using Int = __m256i;
+        struct Phase { __m256i lo, hi; };
+
+        static Float loadFloat(const float* p) { return _mm256_load_ps(p); }
+        static Int loadInt(const int* p) { return _mm256_load_si256(reinterpret_cast<const __m256i*>(p)); }
+        static Phase loadPhase(const std::uint64_t* p)
+        {
+            return { _mm256_load_si256(reinterpret_cast<const __m256i*>(p)), _mm256_load_si256(reinterpret_cast<const __m256i*>(p + 4)) };
+        }
+        static void storeFloat(float* p, Float v) { _mm256_store_ps(p, v); }
+        static void storeInt(int* p, Int v) { _mm256_store_si256(reinterpret_cast<__m256i*>(p), v); }
+        static void storePhase(std::uint64_t* p, Phase v)
+        {
+            _mm256_store_si256(reinterpret_cast<__m256i*>(p), v.lo);
+            _mm256_store_si256(reinterpret_cast<__m256i*>(p + 4), v.hi);
+        }
+
+        static Int broadcastInt(int v) { return _mm256_set1_epi32(v); }
+        static Float broadcastFloat(float v) { return _mm256_set1_ps(v); }
+
+        static Float add(Float a, Float b) { return _mm256_add_ps(a, b); }
+        static Float sub(Float a, Float b) { return _mm256_sub_ps(a, b); }
+        static Float mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+        static Int addInt(Int a, Int b) { return _mm256_add_epi32(a, b); }
+        static Phase addPhase(Phase a, Phase b) { return { _mm256_add_epi64(a.lo, b.lo), _mm256_add_epi64(a.hi, b.hi) }; }
+
+        static Int greaterThan(Int a, Int b) { return _mm256_cmpgt_epi32(a, b); }
+        static Int andInt(Int a, Int b) { return _mm256_and_si256(a, b); }
+        static Int andNotInt(Int a, Int b) { return _mm256_andnot_si256(a, b); }
+        static Float maskFloat(Float v, Int mask) { return _mm256_and_ps(v, _mm256_castsi256_ps(mask)); }
+        template <int bits> static Int shiftLeft(Int v) { return _mm256_slli_epi32(v, bits); }
+        template <int bits> static Int shiftRight(Int v) { return _mm256_srli_epi32(v, bits); }
+        static Float toFloat(Int v) { return _mm256_cvtepi32_ps(v); }
+        static Phase maskPhase(Phase v, Int mask)
+        {
+            return { _mm256_and_si256(v.lo, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(mask))),
+                     _mm256_and_si256(v.hi, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(mask, 1))) };
+        }
+
+        // The shuffle works within 128 bit halves, the permute puts the quads back in lane order
+        static Int index(Phase v)
+        {
+            const auto upper = _mm256_shuffle_ps(_mm256_castsi256_ps(v.lo), _mm256_castsi256_ps(v.hi), _MM_SHUFFLE(3, 1, 3, 1));
+            return _mm256_permute4x64_epi64(_mm256_castps_si256(upper), _MM_SHUFFLE(3, 1, 2, 0));
+        }
+        // Lower 32 bits of every phase
+        static Int fraction(Phase v)
+        {
+            const auto lower = _mm256_shuffle_ps(_mm256_castsi256_ps(v.lo), _mm256_castsi256_ps(v.hi), _MM_SHUFFLE(2, 0, 2, 0));
+            return _mm256_permute4x64_epi64(_mm256_castps_si256(lower), _MM_SHUFFLE(3, 1, 2, 0));
+        }
+
+        static Float gather(const float* base, Int index) { return _mm256_i32gather_ps(base, index, 4); }
+        // Gathers 32 bits at every 16 bit sample and sign extends the lower half, SampleStorage pads the end for this
+        static Float gather(const std::int16_t* base, Int index)
+        {
+            const auto pairs = _mm256_i32gather_epi32(reinterpret_cast<const int*>(base), index, 2);
+            return _mm256_cvtepi32_ps(_mm256_srai_epi32(_mm256_slli_epi32(pairs, 16), 16));
+        }
+
+        // Lane i of the result is the sum of the lanes of v[i]. The horizontal adds sum within 128 bit halves,
+        // the halves of every sum are added at the end
+        static Float sumEach(const Float* v)
+        {
+            const auto first = _mm256_hadd_ps(_mm256_hadd_ps(v[0], v[1]), _mm256_hadd_ps(v[2], v[3]));
+            const auto second = _mm256_hadd_ps(_mm256_hadd_ps(v[4], v[5]), _mm256_hadd_ps(v[6], v[7]));
+            return _mm256_add_ps(_mm256_permute2f128_ps(first, second, 0x20), _mm256_permute2f128_ps(first, second, 0x31));
+        }
+        static void accumulate(float* p, Float v) { _mm256_storeu_ps(p, _mm256_add_ps(_mm256_loadu_ps(p), v)); }
+    };
+}
+
+GrainKernels::RenderFunction GrainKernels::getAVX2RenderFunction(Interpolation interpolation, SampleFormat format)
+{
+    return getLanesRenderFunction<AVX2Lanes>(interpolation, format);
+}
+
+#endif
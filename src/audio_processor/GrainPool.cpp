@@ -0,0 +1,112 @@
+#include "./GrainPool.h"
+#include "./GrainBank.h"
+
+GrainPool::GrainPool()
+    : mWindows(GrainWindows::getInstance())
+{
+}
+
+void GrainPool::prepare(int maxNumGrains)
+{
+    mCapacity = maxNumGrains;
+
+    mPhaseLeft.allocate(mCapacity);
+    mPhaseRight.allocate(mCapacity);
+    mPhaseIncrement.allocate(mCapacity);
+    mLevel.allocate(mCapacity);
+
+    mWindowOffset.allocate(mCapacity);
+    mWindowPhase.allocate(mCapacity);
+    mWindowIncrement.allocate(mCapacity);
+    mAmplitude.allocate(mCapacity);
+    mPanLeft.allocate(mCapacity);
+    mPanRight.allocate(mCapacity);
+
+    mSamplesRemaining.allocate(mCapacity);
+    mStartOffset.allocate(mCapacity);
+    mSamplesToProcess.allocate(mCapacity);
+
+    mOwner.allocate(mCapacity);
+    mActiveIndex.allocate(mCapacity);
+
+    mFreeGrains.allocate(mCapacity);
+    mUsedGrains.allocate(mCapacity);
+    mUsedIndex.allocate(mCapacity);
+    mNumFree = mCapacity;
+    for (int i = 0; i < mCapacity; i++)
+        mFreeGrains[i] = mCapacity - 1 - i;
+
+    mBudget = juce::jmin(mBudget == 0 ? mCapacity : mBudget, mCapacity);
+}
+
+void GrainPool::setBudget(int maxActiveGrains) noexcept
+{
+    mBudget = juce::jlimit(1, juce::jmax(1, mCapacity), maxActiveGrains);
+}
+
+int GrainPool::acquireGrain(GrainBank& owner)
+{
+    int grain;
+    if (mNumFree > 0 && getNumActiveGrains() < mBudget)
+    {
+        grain = mFreeGrains[--mNumFree];
+
+        const auto usedIndex = getNumActiveGrains() - 1;
+        mUsedIndex[grain] = usedIndex;
+        mUsedGrains[usedIndex] = grain;
+    }
+    else
+    {
+        grain = findGrainToSteal();
+        if (grain < 0)
+            return -1;
+
+        mOwner[grain]->removeGrain(grain);
+        mNumStolenGrains.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    mOwner[grain] = &owner;
+    return grain;
+}
+
+void GrainPool::releaseGrain(int grain) noexcept
+{
+    mOwner[grain] = nullptr;
+
+    const auto lastGrain = mUsedGrains[getNumActiveGrains() - 1];
+    mUsedGrains[mUsedIndex[grain]] = lastGrain;
+    mUsedIndex[lastGrain] = mUsedIndex[grain];
+
+    mFreeGrains[mNumFree++] = grain;
+}
+
+float GrainPool::getGrainLevel(int grain) const noexcept
+{
+    return mAmplitude[grain] * mWindows.getValue(mWindowOffset[grain], mWindowPhase[grain]);
+}
+
+int GrainPool::findGrainToSteal() const
+{
+    auto grainToSteal = -1;
+    auto lowestLevel = std::numeric_limits<float>::max();
+
+    for (int k = 0; k < getNumActiveGrains(); k++)
+    {
+        const auto grain = mUsedGrains[k];
+        const auto* owner = mOwner[grain];
+        if (owner == nullptr)
+            continue;
+
+        // Grains that are still fading in count as loud as they are going to get
+        const auto fadingIn = mWindowPhase[grain] < (1u << 31);
+        const auto level = (fadingIn ? mAmplitude[grain] : getGrainLevel(grain)) * owner->getVoiceLevel();
+
+        if (level < lowestLevel)
+        {
+            lowestLevel = level;
+            grainToSteal = grain;
+        }
+    }
+
+    return grainToSteal;
+}
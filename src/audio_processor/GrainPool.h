@@ -0,0 +1,114 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <juce_core/juce_core.h>
+
+#include "GrainWindows.h"
+
+class GrainBank;
+
+/**
+ * Fixed size array whose first element is aligned for SIMD loads and stores.
+ */
+template <typename Type>
+class AlignedArray
+{
+public:
+    void allocate(int numElements)
+    {
+        mStorage.calloc((size_t) numElements * sizeof(Type) + kAlignment);
+        auto address = reinterpret_cast<std::uintptr_t>(mStorage.get());
+        mData = reinterpret_cast<Type*>((address + kAlignment - 1) & ~(kAlignment - 1));
+    }
+
+    Type* get() const noexcept { return mData; }
+    Type& operator[](int index) const noexcept { return mData[index]; }
+
+private:
+    static constexpr std::uintptr_t kAlignment = 32;
+
+    juce::HeapBlock<char> mStorage;
+    Type* mData = nullptr;
+};
+
+/**
+ * The state of every grain of the synth in structure-of-arrays layout, shared by the GrainBanks of all voices.
+ * At most getBudget() grains play at once, when a voice needs one more the quietest grain of any voice is stolen.
+ * Grains are handed out and stolen on the audio thread only.
+ */
+class GrainPool
+{
+public:
+    GrainPool();
+
+    // Allocates maxNumGrains grains, must not be called while any GrainBank holds grains
+    void prepare(int maxNumGrains);
+
+    // Limits the number of grains that play at once, at most the capacity
+    void setBudget(int maxActiveGrains) noexcept;
+
+    int getBudget() const noexcept { return mBudget; }
+    int getCapacity() const noexcept { return mCapacity; }
+    int getNumActiveGrains() const noexcept { return mCapacity - mNumFree; }
+
+    // Number of grains that were stolen because the budget was used up, for debugging
+    int getNumStolenGrains() const noexcept { return mNumStolenGrains.load(std::memory_order_relaxed); }
+
+    /**
+     * Returns a grain owned by owner. If the budget is used up, the quietest grain is taken from its bank,
+     * weighted by the level of the voice that owns it. Returns -1 if there is no grain to hand out.
+     */
+    int acquireGrain(GrainBank& owner);
+
+    void releaseGrain(int grain) noexcept;
+
+    // Envelope level of a grain at its current position
+    float getGrainLevel(int grain) const noexcept;
+
+    // Largest budget the "Grain Budget" parameter can ask for
+    static constexpr int kMaxNumGrains = 4096;
+
+private:
+    friend class GrainBank;
+
+    int findGrainToSteal() const;
+
+    //==========================================================================================
+
+    AlignedArray<std::uint64_t> mPhaseLeft;
+    AlignedArray<std::uint64_t> mPhaseRight;
+    AlignedArray<std::uint64_t> mPhaseIncrement;
+    AlignedArray<int> mLevel;
+
+    AlignedArray<int> mWindowOffset;
+    AlignedArray<std::uint32_t> mWindowPhase;
+    AlignedArray<std::uint32_t> mWindowIncrement;
+    AlignedArray<float> mAmplitude;
+    AlignedArray<float> mPanLeft;
+    AlignedArray<float> mPanRight;
+
+    AlignedArray<int> mSamplesRemaining;
+    AlignedArray<int> mStartOffset;
+    AlignedArray<int> mSamplesToProcess;
+
+    // The bank that owns a grain and where the grain sits in that bank's active list
+    AlignedArray<GrainBank*> mOwner;
+    AlignedArray<int> mActiveIndex;
+
+    AlignedArray<int> mFreeGrains;
+
+    // The grains that are not free and where each sits in that list, so stealing only looks at those
+    AlignedArray<int> mUsedGrains;
+    AlignedArray<int> mUsedIndex;
+
+    int mNumFree = 0;
+    int mCapacity = 0;
+    int mBudget = 0;
+    std::atomic<int> mNumStolenGrains { 0 };
+
+    const GrainWindows& mWindows;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(GrainPool)
+};
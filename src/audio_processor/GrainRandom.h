@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <juce_core/juce_core.h>
+
+/**
+ * PCG32 generator that produces the random values of all grains spawned in a block in one go.
+ * fillBatch runs a tight loop without branches, next() is then just a read from the batch.
+ */
+class GrainRandom
+{
+public:
+    explicit GrainRandom(std::uint64_t seed)
+    {
+        mState = seed + kIncrement;
+        nextUInt32();
+    }
+
+    // Allocates room for maxNumValues values per batch, must not be called from the audio thread
+    void prepare(int maxNumValues)
+    {
+        mBatch.calloc((size_t) maxNumValues);
+        mCapacity = maxNumValues;
+        mNumValues = mNextValue = 0;
+    }
+
+    // Replaces the batch with numValues uniform values in [0, 1)
+    void fillBatch(int numValues) noexcept
+    {
+        mNumValues = juce::jmin(numValues, mCapacity);
+        mNextValue = 0;
+
+        for (int i = 0; i < mNumValues; i++)
+            mBatch[i] = (float) (nextUInt32() >> 8) * (1.f / 16777216.f);
+    }
+
+    float next() noexcept
+    {
+        jassert(mNextValue < mNumValues);
+        return mNextValue < mNumValues ? mBatch[mNextValue++] : 0.5f;
+    }
+
+    // Uniform value in [-1, 1)
+    float nextBipolar() noexcept { return 2.f * next() - 1.f; }
+
+private:
+    std::uint32_t nextUInt32() noexcept
+    {
+        const auto oldState = mState;
+        mState = oldState * 6364136223846793005ULL + kIncrement;
+
+        const auto xorShifted = (std::uint32_t) (((oldState >> 18u) ^ oldState) >> 27u);
+        const auto rotation = (std::uint32_t) (oldState >> 59u);
+        return (xorShifted >> rotation) | (xorShifted << ((0u - rotation) & 31u));
+    }
+
+    static constexpr std::uint64_t kIncrement = 1442695040888963407ULL;
+
+    std::uint64_t mState = 0;
+    juce::HeapBlock<float> mBatch;
+    int mCapacity = 0;
+    int mNumValues = 0;
+    int mNextValue = 0;
+
+    JUCE_DECLARE_NON_COPYABLE(GrainRandom)
+};
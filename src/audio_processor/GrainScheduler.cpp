@@ -0,0 +1,82 @@
+#include "./GrainScheduler.h"
+
+GrainScheduler::GrainScheduler(std::uint64_t seed)
+    : mRandom(seed)
+{
+}
+
+void GrainScheduler::prepare(int maxBlockSize)
+{
+    // One jitter value per grid point, the interval is at least one sample
+    mRandom.prepare(juce::jmax(1, maxBlockSize) + 1);
+    reset();
+}
+
+void GrainScheduler::reset() noexcept
+{
+    mNumQueued = 0;
+    mNextGridPoint = 0.;
+}
+
+int GrainScheduler::getNextOnsets(int numSamples, double interval, float jitter, int* onsets) noexcept
+{
+    interval = juce::jmax(1., interval);
+    const auto jitterRange = (double) juce::jlimit(0.f, 1.f, jitter) * interval;
+
+    // A longer interval than last block would otherwise keep the next grid point far away after a fast setting
+    mNextGridPoint = juce::jmin(mNextGridPoint, interval + jitterRange);
+
+    // Every grid point that can land inside this block is queued now
+    const auto numGridPoints = juce::jmax(0, (int) std::ceil(((double) numSamples + jitterRange - mNextGridPoint) / interval));
+    mRandom.fillBatch(numGridPoints);
+
+    auto numOnsets = 0;
+    for (int k = 0; k < numGridPoints; k++)
+    {
+        pushOnset(mNextGridPoint + jitterRange * mRandom.nextBipolar());
+        mNextGridPoint += interval;
+
+        // Later grid points can not land before this, so everything in front of it is in order
+        numOnsets += popOnsetsBefore(juce::jmin((double) numSamples, mNextGridPoint - jitterRange), onsets + numOnsets);
+    }
+    numOnsets += popOnsetsBefore((double) numSamples, onsets + numOnsets);
+
+    // Whatever is left happens in one of the next blocks
+    for (int i = 0; i < mNumQueued; i++)
+        mQueue[(size_t) i] -= numSamples;
+
+    mNextGridPoint -= numSamples;
+
+    return numOnsets;
+}
+
+void GrainScheduler::pushOnset(double onset) noexcept
+{
+    jassert(mNumQueued < kMaxNumQueued);
+    if (mNumQueued == kMaxNumQueued)
+        return;
+
+    // Insertion sort, the queue only ever holds a handful of onsets
+    auto i = mNumQueued++;
+    for (; i > 0 && mQueue[(size_t) i - 1] > onset; i--)
+        mQueue[(size_t) i] = mQueue[(size_t) i - 1];
+
+    mQueue[(size_t) i] = onset;
+}
+
+int GrainScheduler::popOnsetsBefore(double time, int* onsets) noexcept
+{
+    auto numPopped = 0;
+    while (numPopped < mNumQueued && mQueue[(size_t) numPopped] < time)
+    {
+        // Jitter can push the first onsets of a note before the start of the block
+        onsets[numPopped] = juce::jmax(0, (int) mQueue[(size_t) numPopped]);
+        numPopped++;
+    }
+
+    for (int i = numPopped; i < mNumQueued; i++)
+        mQueue[(size_t) (i - numPopped)] = mQueue[(size_t) i];
+
+    mNumQueued -= numPopped;
+    return numPopped;
+}
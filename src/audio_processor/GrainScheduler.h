@@ -0,0 +1,53 @@
+#pragma once
+
+#include <array>
+#include <juce_core/juce_core.h>
+
+#include "GrainRandom.h"
+
+/**
+ * Schedules the grain onsets of a voice, sample accurate and independent of the block size.
+ *
+ * Onsets sit on a grid with a fractional interval and can be jittered around their grid point. Jittered onsets
+ * can overtake each other, so the upcoming ones are kept in a small sorted queue until no later grid point
+ * can land before them anymore.
+ */
+class GrainScheduler
+{
+public:
+    explicit GrainScheduler(std::uint64_t seed);
+
+    // Allocates the random values for blocks of up to maxBlockSize samples, must not be called from the audio thread
+    void prepare(int maxBlockSize);
+
+    // Starts a new note, the first onset is at the start of the next block
+    void reset() noexcept;
+
+    /**
+     * Writes the onsets that fall inside the next numSamples samples to onsets, in ascending order, and returns
+     * how many there are. onsets needs room for getMaxNumOnsets(numSamples) values.
+     *
+     * interval is the distance between grid points in samples, jitter moves every onset by up to
+     * jitter * interval samples in either direction.
+     */
+    int getNextOnsets(int numSamples, double interval, float jitter, int* onsets) noexcept;
+
+    static constexpr int getMaxNumOnsets(int numSamples) { return numSamples + 1 + kMaxNumQueued; }
+
+private:
+    void pushOnset(double onset) noexcept;
+    int popOnsetsBefore(double time, int* onsets) noexcept;
+
+    // With at most one interval of jitter no more than three onsets can be waiting at a time
+    static constexpr int kMaxNumQueued = 4;
+
+    std::array<double, kMaxNumQueued> mQueue {};
+    int mNumQueued = 0;
+
+    // Next grid point, relative to the start of the block
+    double mNextGridPoint = 0.;
+
+    GrainRandom mRandom;
+
+    JUCE_DECLARE_NON_COPYABLE(GrainScheduler)
+};
@@ -0,0 +1,70 @@
+#include "./GrainSnapshot.h"
+
+namespace
+{
+    // A copy is a few microseconds of work, more retries than this mean the audio thread keeps overtaking us
+    constexpr int kMaxReadAttempts = 4;
+}
+
+void GrainSnapshot::beginWrite() noexcept
+{
+    mSequence.store(mSequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    mNumWritten = 0;
+}
+
+void GrainSnapshot::addGrain(const Grain& grain) noexcept
+{
+    if (mNumWritten < kMaxNumGrains)
+    {
+        auto& shared = mGrains[(size_t) mNumWritten];
+        shared.position.store(grain.position, std::memory_order_relaxed);
+        shared.amplitude.store(grain.amplitude, std::memory_order_relaxed);
+        shared.spread.store(grain.spread, std::memory_order_relaxed);
+    }
+
+    mNumWritten++;
+}
+
+void GrainSnapshot::endWrite(int numActiveVoices) noexcept
+{
+    mNumGrains.store(mNumWritten, std::memory_order_relaxed);
+    mNumActiveVoices.store(numActiveVoices, std::memory_order_relaxed);
+    mSequence.store(mSequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+bool GrainSnapshot::read(Contents& contents) const
+{
+    std::vector<Grain> grains;
+
+    for (int attempt = 0; attempt < kMaxReadAttempts; attempt++)
+    {
+        const auto sequence = mSequence.load(std::memory_order_acquire);
+        if ((sequence & 1) != 0)
+            continue;
+
+        const auto numGrains = mNumGrains.load(std::memory_order_relaxed);
+        const auto numActiveVoices = mNumActiveVoices.load(std::memory_order_relaxed);
+        const auto numCopied = juce::jmin(numGrains, kMaxNumGrains);
+
+        grains.resize((size_t) numCopied);
+        for (int i = 0; i < numCopied; i++)
+        {
+            const auto& shared = mGrains[(size_t) i];
+            grains[(size_t) i] = { shared.position.load(std::memory_order_relaxed),
+                                  shared.amplitude.load(std::memory_order_relaxed),
+                                  shared.spread.load(std::memory_order_relaxed) };
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (mSequence.load(std::memory_order_relaxed) != sequence)
+            continue;
+
+        contents.grains.swap(grains);
+        contents.numGrains = numGrains;
+        contents.numActiveVoices = numActiveVoices;
+        return true;
+    }
+
+    return false;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <vector>
+#include <juce_core/juce_core.h>
+
+/**
+ * What the editor shows of the grains that are playing, copied out by the audio thread every few blocks.
+ *
+ * The audio thread writes without waiting, the editor reads the latest complete copy. A sequence number that is
+ * odd while a copy is being written tells the reader to try again, the fields themselves are relaxed atomics.
+ */
+class GrainSnapshot
+{
+public:
+    struct Grain
+    {
+        float position = 0.f;   // of the left channel, relative to the length of the sample
+        float amplitude = 0.f;  // envelope level of the grain
+        float spread = 0.f;     // where the grain is among the grains of its voice, from 0 to 1
+    };
+
+    struct Contents
+    {
+        std::vector<Grain> grains;
+        int numGrains = 0;          // may be more than grains holds
+        int numActiveVoices = 0;
+    };
+
+    // Audio thread only. Grains beyond kMaxNumGrains are counted but not copied
+    void beginWrite() noexcept;
+    void addGrain(const Grain& grain) noexcept;
+    void endWrite(int numActiveVoices) noexcept;
+
+    // Fills contents with the latest copy, returns false and leaves it alone if none could be read
+    bool read(Contents& contents) const;
+
+    static constexpr int kMaxNumGrains = 1024;
+
+private:
+    struct SharedGrain
+    {
+        std::atomic<float> position { 0.f };
+        std::atomic<float> amplitude { 0.f };
+        std::atomic<float> spread { 0.f };
+    };
+
+    std::atomic<juce::uint32> mSequence { 0 };
+    std::atomic<int> mNumGrains { 0 };
+    std::atomic<int> mNumActiveVoices { 0 };
+    std::array<SharedGrain, kMaxNumGrains> mGrains;
+
+    // Grains added since beginWrite, audio thread only
+    int mNumWritten = 0;
+};
@@ -0,0 +1,73 @@
+#include "./GrainWindows.h"
+
+namespace
+{
+    // x runs from 0 at the start to 1 at the end of the grain
+    float computeWindow(GrainWindows::Shape shape, double x)
+    {
+        const auto pi = juce::MathConstants<double>::pi;
+
+        switch (shape)
+        {
+            case GrainWindows::Shape::triangle:
+                return (float) (1. - std::abs(2. * x - 1.));
+
+            case GrainWindows::Shape::hann:
+                return (float) (0.5 - 0.5 * std::cos(2. * pi * x));
+
+            case GrainWindows::Shape::tukey:
+            {
+                // Cosine tapers over the outer quarters, flat in between
+                const auto taper = 0.25;
+                const auto edge = juce::jmin(x, 1. - x);
+                return edge >= taper ? 1.f : (float) (0.5 - 0.5 * std::cos(pi * edge / taper));
+            }
+
+            case GrainWindows::Shape::gaussian:
+            {
+                // Shifted and rescaled so that it starts and ends at zero instead of clicking
+                const auto sigma = 0.4;
+                const auto gauss = [sigma] (double t) { return std::exp(-0.5 * std::pow((t - 0.5) / (sigma * 0.5), 2.)); };
+                return (float) ((gauss(x) - gauss(0.)) / (1. - gauss(0.)));
+            }
+
+            case GrainWindows::Shape::blackman:
+                return (float) juce::jmax(0., 0.42 - 0.5 * std::cos(2. * pi * x) + 0.08 * std::cos(4. * pi * x));
+
+            case GrainWindows::Shape::trapezoid:
+                return (float) juce::jmin(1., 4. * juce::jmin(x, 1. - x));
+        }
+
+        return 0.f;
+    }
+}
+
+juce::StringArray GrainWindows::getShapeNames()
+{
+    return { "Triangle", "Hann", "Tukey", "Gaussian", "Blackman", "Trapezoid" };
+}
+
+const GrainWindows& GrainWindows::getInstance()
+{
+    static const GrainWindows instance;
+    return instance;
+}
+
+GrainWindows::GrainWindows()
+    : mTables((size_t) (kNumShapes * kTableStride))
+{
+    for (int shape = 0; shape < kNumShapes; shape++)
+    {
+        auto* table = mTables.data() + shape * kTableStride;
+
+        for (int i = 0; i < kTableStride; i++)
+            table[i] = computeWindow((Shape) shape, (double) i / GrainKernels::kWindowTableSize);
+    }
+}
+
+float GrainWindows::getValue(int tableOffset, std::uint32_t phase) const noexcept
+{
+    const auto* table = mTables.data() + tableOffset + (phase >> GrainKernels::kWindowIndexShift);
+    const auto alpha = GrainKernels::getWindowFraction(phase);
+    return table[0] + alpha * (table[1] - table[0]);
+}
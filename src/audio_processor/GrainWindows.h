@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <juce_core/juce_core.h>
+
+#include "GrainKernels.h"
+
+/**
+ * Precomputed grain envelope windows. All shapes live in one table so a grain only needs an offset
+ * into it, grains with different shapes can then be rendered in the same SIMD lanes.
+ */
+class GrainWindows
+{
+public:
+    // Keep in sync with getShapeNames, the order is the order of the "Grain Envelope Shape" choices
+    enum class Shape
+    {
+        triangle,
+        hann,
+        tukey,
+        gaussian,
+        blackman,
+        trapezoid
+    };
+
+    static constexpr int kNumShapes = 6;
+
+    static juce::StringArray getShapeNames();
+
+    /**
+     * The tables are built on first use. Call this from the message thread before audio starts,
+     * the GrainBank constructor does so.
+     */
+    static const GrainWindows& getInstance();
+
+    const float* getTables() const noexcept { return mTables.data(); }
+    int getTableOffset(Shape shape) const noexcept { return (int) shape * kTableStride; }
+
+    // Window value at a 0.32 fixed-point phase running from the start to the end of a grain
+    float getValue(int tableOffset, std::uint32_t phase) const noexcept;
+
+private:
+    GrainWindows();
+
+    // One extra entry at the end of every table for the interpolation
+    static constexpr int kTableStride = GrainKernels::kWindowTableSize + 1;
+
+    std::vector<float> mTables;
+
+    JUCE_DECLARE_NON_COPYABLE(GrainWindows)
+};
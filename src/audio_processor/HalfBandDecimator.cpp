@@ -0,0 +1,142 @@
+#include "./HalfBandDecimator.h"
+
+namespace
+{
+    // Kaiser window parameter for about 90 dB of stopband attenuation
+    constexpr double kKaiserBeta = 9.;
+
+    // The last stage passes up to 0.44 of the output rate with more than 85 dB of alias rejection, the stage
+    // in front of it only has to keep its aliasing out of the band that the last stage passes
+    constexpr int kNumPairsLastStage = 24;
+    constexpr int kNumPairsFirstStage = 6;
+
+    double besselI0(double x)
+    {
+        auto sum = 1.;
+        auto term = 1.;
+        for (int k = 1; k < 32; k++)
+        {
+            term *= (x / (2. * k)) * (x / (2. * k));
+            sum += term;
+        }
+
+        return sum;
+    }
+}
+
+HalfBandFilter::HalfBandFilter(int numPairs)
+    : mNumPairs(numPairs),
+      mLength(4 * numPairs - 1),
+      mCentre(2 * numPairs - 1)
+{
+    mCoefficients.calloc((size_t) mNumPairs);
+
+    auto sum = 0.;
+    for (int j = 0; j < mNumPairs; j++)
+    {
+        const auto offset = 2 * j + 1;
+        const auto x = 0.5 * juce::MathConstants<double>::pi * offset;
+        const auto edge = (double) offset / (double) (mCentre + 1);
+        const auto window = besselI0(kKaiserBeta * std::sqrt(1. - edge * edge)) / besselI0(kKaiserBeta);
+        const auto coefficient = 0.5 * std::sin(x) / x * window;
+
+        mCoefficients[j] = (float) coefficient;
+        sum += 2. * coefficient;
+    }
+
+    // Unity gain at DC, the centre tap contributes the other half
+    for (int j = 0; j < mNumPairs; j++)
+        mCoefficients[j] = (float) (mCoefficients[j] * 0.5 / sum);
+}
+
+void HalfBandFilter::prepare(int maxNumInputSamples)
+{
+    mMaxNumInputSamples = maxNumInputSamples;
+    mHistory.calloc((size_t) (mLength - 1 + maxNumInputSamples));
+}
+
+void HalfBandFilter::reset() noexcept
+{
+    juce::FloatVectorOperations::clear(mHistory.get(), mLength - 1);
+}
+
+void HalfBandFilter::process(const float* input, float* output, int numInputSamples) noexcept
+{
+    jassert(numInputSamples % 2 == 0 && numInputSamples <= mMaxNumInputSamples);
+
+    auto* samples = mHistory.get();
+    juce::FloatVectorOperations::copy(samples + mLength - 1, input, numInputSamples);
+
+    for (int n = 0; n < numInputSamples / 2; n++)
+    {
+        // Output n is centred on input 2n + 1 - mCentre, the newest input it sees is 2n + 1
+        const auto* centre = samples + mLength + 2 * n - mCentre;
+        auto sum = 0.5f * centre[0];
+
+        for (int j = 0; j < mNumPairs; j++)
+            sum += mCoefficients[j] * (centre[2 * j + 1] + centre[-2 * j - 1]);
+
+        output[n] = sum;
+    }
+
+    // Keep the tail for the next block
+    std::memmove(samples, samples + numInputSamples, sizeof(float) * (size_t) (mLength - 1));
+}
+
+HalfBandDecimator::HalfBandDecimator()
+    : mFilters { { HalfBandFilter(kNumPairsLastStage), HalfBandFilter(kNumPairsFirstStage) },
+                 { HalfBandFilter(kNumPairsLastStage), HalfBandFilter(kNumPairsFirstStage) } }
+{
+}
+
+void HalfBandDecimator::prepare(int maxBlockSize)
+{
+    for (auto& channel : mFilters)
+    {
+        channel[0].prepare(2 * maxBlockSize);
+        channel[1].prepare(4 * maxBlockSize);
+    }
+
+    mIntermediate.setSize(2, 2 * maxBlockSize, false, true, false);
+    mDecimated.setSize(2, maxBlockSize, false, true, false);
+    reset();
+}
+
+int HalfBandDecimator::getLatency(int factor) const noexcept
+{
+    // Every stage delays by its centre tap at its own input rate
+    auto latency = (double) mFilters[0][0].getLatency() / 2.;
+    if (factor == 4)
+        latency += (double) mFilters[0][1].getLatency() / 4.;
+
+    return factor == 1 ? 0 : juce::roundToInt(latency);
+}
+
+void HalfBandDecimator::reset() noexcept
+{
+    for (auto& channel : mFilters)
+        for (auto& filter : channel)
+            filter.reset();
+}
+
+void HalfBandDecimator::process(const juce::AudioBuffer<float>& input, juce::AudioBuffer<float>& output,
+                                int startSample, int numSamples, int factor) noexcept
+{
+    jassert(factor == 2 || factor == 4);
+    jassert(numSamples <= mDecimated.getNumSamples());
+
+    for (int channel = 0; channel < 2; channel++)
+    {
+        const auto* source = input.getReadPointer(channel);
+        if (factor == 4)
+        {
+            mFilters[channel][1].process(source, mIntermediate.getWritePointer(channel), 4 * numSamples);
+            source = mIntermediate.getReadPointer(channel);
+        }
+
+        mFilters[channel][0].process(source, mDecimated.getWritePointer(channel), 2 * numSamples);
+
+        if (channel < output.getNumChannels())
+            output.addFrom(channel, startSample, mDecimated, channel, 0, numSamples);
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+/**
+ * Half-band lowpass FIR that halves the sample rate of one channel, in polyphase form.
+ * Every other coefficient of a half-band filter is zero, so each output sample only takes the centre tap
+ * of one phase plus numPairs symmetric coefficient pairs of the other.
+ */
+class HalfBandFilter
+{
+public:
+    explicit HalfBandFilter(int numPairs);
+
+    // Allocates room for blocks of up to maxNumInputSamples, must not be called from the audio thread
+    void prepare(int maxNumInputSamples);
+    void reset() noexcept;
+
+    // Filters an even number of input samples and writes half as many to output
+    void process(const float* input, float* output, int numInputSamples) noexcept;
+
+    // Delay of the filter in input samples
+    int getLatency() const noexcept { return mCentre; }
+
+private:
+    int mNumPairs;
+    int mLength;
+    int mCentre;
+
+    // The coefficient of the taps centre - (2j + 1) and centre + (2j + 1)
+    juce::HeapBlock<float> mCoefficients;
+
+    // The last mLength - 1 input samples followed by the current block
+    juce::HeapBlock<float> mHistory;
+    int mMaxNumInputSamples = 0;
+
+    JUCE_DECLARE_NON_COPYABLE(HalfBandFilter)
+};
+
+/**
+ * Brings the stereo grain mix that was rendered at 2 or 4 times the output rate back down, one half-band stage
+ * per octave. The stage at the highest rate has a wide transition band and gets away with a short filter.
+ */
+class HalfBandDecimator
+{
+public:
+    HalfBandDecimator();
+
+    // Allocates for output blocks of up to maxBlockSize samples, must not be called from the audio thread
+    void prepare(int maxBlockSize);
+    void reset() noexcept;
+
+    // Decimates numSamples * factor samples of the first two channels of input and adds them to output
+    void process(const juce::AudioBuffer<float>& input, juce::AudioBuffer<float>& output,
+                 int startSample, int numSamples, int factor) noexcept;
+
+    // Group delay in output samples when decimating by factor, rounded to a whole sample
+    int getLatency(int factor) const noexcept;
+
+    // Longest output block process accepts, the maxBlockSize of prepare
+    int getMaxBlockSize() const noexcept { return mDecimated.getNumSamples(); }
+
+    static constexpr int kMaxFactor = 4;
+
+private:
+    // [channel][stage], stage 0 runs at twice the output rate
+    HalfBandFilter mFilters[2][2];
+
+    juce::AudioBuffer<float> mIntermediate;
+    juce::AudioBuffer<float> mDecimated;
+
+    JUCE_DECLARE_NON_COPYABLE(HalfBandDecimator)
+};
@@ -0,0 +1,36 @@
+#include "./Keymap.h"
+
+void Keymap::addZone(MultigrainSound* sound)
+{
+    mZones.add(sound);
+
+    for (int note = 0; note < kNumNotes; note++)
+        if (sound->appliesToNote(note))
+            mSoundForNote[(size_t) note] = sound;
+}
+
+juce::Array<juce::BigInteger> Keymap::splitKeyboard(const juce::Array<int>& rootNotes)
+{
+    juce::Array<juce::BigInteger> noteMasks;
+    noteMasks.resize(rootNotes.size());
+
+    if (rootNotes.isEmpty())
+        return noteMasks;
+
+    for (int note = 0; note < kNumNotes; note++)
+    {
+        // Ties go to the zone with the higher root, samples pitched down do not alias
+        auto closest = 0;
+        for (int zone = 1; zone < rootNotes.size(); zone++)
+        {
+            const auto distance = std::abs(rootNotes[zone] - note);
+            const auto closestDistance = std::abs(rootNotes[closest] - note);
+            if (distance < closestDistance || (distance == closestDistance && rootNotes[zone] > rootNotes[closest]))
+                closest = zone;
+        }
+
+        noteMasks.getReference(closest).setBit(note);
+    }
+
+    return noteMasks;
+}
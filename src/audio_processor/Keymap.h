@@ -0,0 +1,42 @@
+#pragma once
+
+#include <array>
+#include <juce_audio_basics/juce_audio_basics.h>
+
+#include "MultigrainSound.h"
+
+/**
+ * Maps every MIDI note to the zone that plays it. A zone is a MultigrainSound, which plays the notes of its note
+ * mask transposed from its own root note. Samples of a multisample that are recorded close to the notes they play
+ * are pitched by ratios near 1, which keeps the cheap interpolation modes clean across the keyboard.
+ *
+ * A keymap does not change once it has been handed to the synth.
+ */
+class Keymap
+{
+public:
+    static constexpr int kNumNotes = 128;
+
+    // Where the notes of zones overlap, the zone added last plays them
+    void addZone(MultigrainSound* sound);
+
+    // nullptr for notes no zone plays
+    MultigrainSound* getSoundForNote(int midiNoteNumber) const noexcept
+    {
+        return juce::isPositiveAndBelow(midiNoteNumber, kNumNotes) ? mSoundForNote[(size_t) midiNoteNumber] : nullptr;
+    }
+
+    const juce::ReferenceCountedArray<MultigrainSound>& getZones() const noexcept { return mZones; }
+
+    /**
+     * Splits the keyboard between zones with these root notes, every note goes to the zone with the closest root.
+     * The lowest zone reaches down to note 0 and the highest up to note 127. Returns a note mask per root note.
+     */
+    static juce::Array<juce::BigInteger> splitKeyboard(const juce::Array<int>& rootNotes);
+
+private:
+    juce::ReferenceCountedArray<MultigrainSound> mZones;
+    std::array<MultigrainSound*, kNumNotes> mSoundForNote {};
+
+    JUCE_LEAK_DETECTOR(Keymap)
+};
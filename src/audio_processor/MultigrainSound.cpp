@@ -4,37 +4,68 @@
 
 #include "./MultigrainSound.h"
 
+namespace
+{
+    // Levels stop once they would get shorter than this
+    constexpr int kMinLevelLength = 64;
+}
+
 
 // MultigrainSound
 MultigrainSound::MultigrainSound(
     const juce::String& soundName,
-    juce::AudioFormatReader& source,
+    std::shared_ptr<const SampleStorage> sampleStorage,
+    std::shared_ptr<const SampleIndex> sampleIndex,
+    double sampleRate,
     const juce::BigInteger& notes,
-    int midiNoteForNormalPitch,
-    double maxSampleLengthSeconds
+    int midiNoteForNormalPitch
 ):
     name(soundName),
-    sourceSampleRate(source.sampleRate),
+    storage(std::move(sampleStorage)),
+    index(std::move(sampleIndex)),
+    sourceSampleRate(sampleRate),
     midiNotes(notes),
     midiRootNote(midiNoteForNormalPitch)
 {
-    if (sourceSampleRate > 0 && source.lengthInSamples > 0)
-    {
-        length = juce::jmin ((int) source.lengthInSamples,
-                             (int) (maxSampleLengthSeconds * sourceSampleRate));
+    jassert(storage != nullptr && storage->isValid() && storage->getNumLevels() > 0);
+    jassert(index != nullptr);
+    length = storage->getLength(0);
+}
 
-        data.reset (new juce::AudioBuffer<float> (juce::jmin (2, (int) source.numChannels), length + 4));
+MultigrainSound::~MultigrainSound() = default;
+
+juce::Array<int> MultigrainSound::getLevelLengths(int length)
+{
+    juce::Array<int> lengths;
+    lengths.add(length);
+    while (lengths.size() < kMaxNumLevels && (lengths.getLast() + 1) / 2 >= kMinLevelLength)
+        lengths.add((lengths.getLast() + 1) / 2);
 
-        source.read (data.get(), 0, length + 4, 0, true, true);
+    return lengths;
+}
+
+void MultigrainSound::prefetch(double position, double radius) const
+{
+    if (!storage->isMemoryMapped())
+        return;
+
+    for (int level = 0; level < storage->getNumLevels(); level++)
+    {
+        const auto scale = 1. / (double) (1 << level);
+        const auto start = (position - radius) * scale;
+        const auto numSamples = 2. * radius * scale + 1.;
+        storage->keepResident(level, (int) std::floor(start), (int) juce::jmin(numSamples, (double) storage->getLength(level)));
     }
 }
 
-MultigrainSound::~MultigrainSound() = default;
+void MultigrainSound::releaseStalePrefetches() const
+{
+    storage->releaseStalePages();
+}
 
-bool MultigrainSound::appliesToNote(int /*midiNoteNumber*/)
+bool MultigrainSound::appliesToNote(int midiNoteNumber)
 {
-    // return midiNotes[midiNoteNumber];
-    return true;
+    return midiNotes[midiNoteNumber];
 }
 
 bool MultigrainSound::appliesToChannel(int /*midiChannel*/)
@@ -7,25 +7,80 @@
 #include <juce_audio_basics/juce_audio_basics.h>
 #include <juce_audio_formats/juce_audio_formats.h>
 
+#include "SampleIndex.h"
+#include "SampleStorage.h"
+
 /**
- * Manages an audio sample buffer and channel-note-mask
+ * Manages an audio sample buffer and channel-note-mask. In a multisample every sound is one zone of the Keymap,
+ * playing the notes of its mask transposed from its own root note.
  */
 class MultigrainSound : public juce::SynthesiserSound
 {
 public:
+    /**
+     * Plays storage, which is laid out for getLevelLengths and has its levels built, index is its analysis.
+     * Sounds made from the same file share their storage and index, see SampleCache.
+     */
     MultigrainSound(
         const juce::String& soundName,
-        juce::AudioFormatReader& source,
+        std::shared_ptr<const SampleStorage> sampleStorage,
+        std::shared_ptr<const SampleIndex> sampleIndex,
+        double sampleRate,
         const juce::BigInteger& notes,
-        int midiNoteForNormalPitch,
-        double maxSampleLengthSecs
+        int midiNoteForNormalPitch
     );
 
     ~MultigrainSound() override;
 
     const juce::String& getName() const noexcept { return name; }
 
-    juce::AudioSampleBuffer* getAudioData() const noexcept { return data.get(); }
+    double getSourceSampleRate() const noexcept { return sourceSampleRate; }
+
+    // The note at which the sample plays at its original pitch
+    int getRootNote() const noexcept { return midiRootNote; }
+
+    // Root note of samples whose name does not say which note they are, the "Root Note" parameter is relative to it
+    static constexpr int kDefaultRootNote = 60;
+
+    /**
+     * The sample is stored as a pyramid of octave levels. Level 0 is the sample itself, every next level
+     * is lowpassed and decimated by 2, so pitching up by more than an octave can read a level without aliasing.
+     */
+    int getNumLevels() const noexcept { return storage->getNumLevels(); }
+    int getLength(int level) const noexcept { return storage->getLength(level); }
+
+    // Lengths of the levels of a sample of length samples
+    static juce::Array<int> getLevelLengths(int length);
+
+    // Whether getReadPointer points to floats or 16 bit integers
+    GrainKernels::SampleFormat getSampleFormat() const noexcept { return storage->getFormat(); }
+
+    /**
+     * Returns a pointer to the first sample of a channel of a level, mono sounds return their only channel.
+     * kGuardSamples wrapped samples can be read before the first and after the last sample.
+     */
+    const void* getReadPointer(int channel, int level = 0) const noexcept
+    {
+        return storage->getReadPointer(juce::jmin(channel, storage->getNumChannels() - 1), level);
+    }
+
+    // Lets interpolators read past either end of the sample without wrapping their read index
+    static constexpr int kGuardSamples = SampleStorage::kGuardSamples;
+
+    /**
+     * Locks the samples within radius of position, both in samples of level 0, in memory on every level, as far
+     * as the OS allows. Does nothing unless the sample is memory-mapped. Must not be called from the audio thread.
+     */
+    void prefetch(double position, double radius) const;
+
+    // Lets the OS page out what prefetch has not been asked to keep for a while
+    void releaseStalePrefetches() const;
+    bool isMemoryMapped() const noexcept { return storage->isMemoryMapped(); }
+
+    // Onsets and zero crossings that grain positions snap to
+    const SampleIndex& getIndex() const noexcept { return *index; }
+
+    static constexpr int kMaxNumLevels = 8;
 
     bool appliesToNote (int midiNoteNumber) override;
     bool appliesToChannel (int midiChannel) override;
@@ -34,11 +89,12 @@ public:
 
 private:
     friend class MultigrainVoice;
-    friend class GrainSource;
+    friend class GrainBank;
 
     juce::String name;
 
-    std::unique_ptr<juce::AudioBuffer<float>> data;
+    std::shared_ptr<const SampleStorage> storage;
+    std::shared_ptr<const SampleIndex> index;
 
     double sourceSampleRate;
 
@@ -0,0 +1,228 @@
+#include "./MultigrainSynthesiser.h"
+
+void MultigrainSynthesiser::prepare(double sampleRate, int samplesPerBlock)
+{
+    mOutputSampleRate = sampleRate;
+    mOversampledBuffer.setSize(2, juce::jmax(1, samplesPerBlock) * kMaxOversamplingFactor, false, true, false);
+    mDecimator.prepare(juce::jmax(1, samplesPerBlock));
+
+    setCurrentPlaybackSampleRate(mOutputSampleRate * mOversamplingFactor);
+}
+
+void MultigrainSynthesiser::setOversamplingFactor(int factor)
+{
+    jassert(factor == 1 || factor == 2 || factor == 4);
+    if (factor == mOversamplingFactor)
+        return;
+
+    mOversamplingFactor = factor;
+    mLatencySamples.store(mDecimator.getLatency(factor), std::memory_order_relaxed);
+    mDecimator.reset();
+    setCurrentPlaybackSampleRate(mOutputSampleRate * mOversamplingFactor);
+}
+
+void MultigrainSynthesiser::prepareVoiceLists()
+{
+    const juce::ScopedLock sl (lock);
+
+    clearActiveList();
+    mFreeVoices.clear();
+    mFreeVoices.reserve((size_t) voices.size());
+    mRenderVoices.clear();
+    mRenderVoices.reserve((size_t) voices.size());
+
+    for (auto* voice : voices)
+        addToFreeList(static_cast<MultigrainVoice*>(voice));
+}
+
+void MultigrainSynthesiser::clearVoiceLists()
+{
+    const juce::ScopedLock sl (lock);
+
+    clearActiveList();
+    mFreeVoices.clear();
+    mRenderVoices.clear();
+}
+
+void MultigrainSynthesiser::noteOn(int midiChannel, int midiNoteNumber, float velocity)
+{
+    const juce::ScopedLock sl (lock);
+
+    auto* sound = mKeymap != nullptr ? mKeymap->getSoundForNote(midiNoteNumber) : nullptr;
+    if (sound == nullptr || !sound->appliesToChannel(midiChannel))
+        return;
+
+    // A retriggered note fades out the voice that still plays it, like juce::Synthesiser does
+    for (auto* voice = mOldestVoice; voice != nullptr; voice = voice->mNewerVoice)
+        if (voice->getCurrentlyPlayingNote() == midiNoteNumber && voice->isPlayingChannel(midiChannel))
+            stopVoice(voice, 1.f, true);
+
+    if (auto* voice = allocateVoice())
+        startVoice(voice, sound, midiChannel, midiNoteNumber, velocity);
+}
+
+void MultigrainSynthesiser::renderVoices(juce::AudioBuffer<float>& outputAudio, int startSample, int numSamples)
+{
+    if (mOversamplingFactor == 1)
+    {
+        renderActiveVoices(outputAudio, startSample, numSamples);
+        return;
+    }
+
+    // Hosts may send longer blocks than they announced, the decimator only has room for the announced length
+    const auto maxBlockSize = juce::jmin(mDecimator.getMaxBlockSize(), mOversampledBuffer.getNumSamples() / mOversamplingFactor);
+
+    while (numSamples > 0)
+    {
+        const auto samplesThisTime = juce::jmin(numSamples, maxBlockSize);
+        const auto oversampledSamples = samplesThisTime * mOversamplingFactor;
+
+        mOversampledBuffer.clear(0, oversampledSamples);
+        renderActiveVoices(mOversampledBuffer, 0, oversampledSamples);
+        mDecimator.process(mOversampledBuffer, outputAudio, startSample, samplesThisTime, mOversamplingFactor);
+
+        startSample += samplesThisTime;
+        numSamples -= samplesThisTime;
+    }
+}
+
+void MultigrainSynthesiser::renderActiveVoices(juce::AudioBuffer<float>& outputAudio, int startSample, int numSamples)
+{
+    if (mThreadPool == nullptr || mOldestVoice == nullptr)
+    {
+        for (auto* voice = mOldestVoice; voice != nullptr; voice = voice->mNewerVoice)
+            voice->renderNextBlock(outputAudio, startSample, numSamples);
+
+        releaseFinishedVoices();
+        return;
+    }
+
+    const auto maxBlockSize = mOldestVoice->getMaxBlockSize();
+
+    // The tasks of the pool find their voice by index
+    mRenderVoices.clear();
+    for (auto* voice = mOldestVoice; voice != nullptr; voice = voice->mNewerVoice)
+        mRenderVoices.push_back(voice);
+
+    while (numSamples > 0)
+    {
+        const auto samplesThisTime = juce::jmin(numSamples, maxBlockSize);
+
+        // Grains are handed out by the pool shared by all voices, so they are scheduled here first
+        auto numPlayingVoices = 0;
+        for (auto* voice : mRenderVoices)
+            if (voice->beginBlock(samplesThisTime))
+                numPlayingVoices++;
+
+        if (numPlayingVoices == 0)
+            break;
+
+        // A single voice is not worth waking the workers for, they park again once the pool is inactive.
+        // Voices that turned out to be silent return straight away
+        mThreadPool->setActive(numPlayingVoices > 1);
+        if (numPlayingVoices > 1)
+        {
+            mThreadPool->run((int) mRenderVoices.size(), [] (void* context, int index)
+            {
+                static_cast<MultigrainSynthesiser*>(context)->mRenderVoices[(size_t) index]->renderBlock();
+            }, this);
+        }
+        else
+        {
+            for (auto* voice : mRenderVoices)
+                voice->renderBlock();
+        }
+
+        for (auto* voice : mRenderVoices)
+            voice->endBlock(outputAudio, startSample);
+
+        startSample += samplesThisTime;
+        numSamples -= samplesThisTime;
+    }
+
+    releaseFinishedVoices();
+}
+
+MultigrainVoice* MultigrainSynthesiser::allocateVoice()
+{
+    releaseFinishedVoices();
+
+    if (mNumActiveVoices < mPolyphony && !mFreeVoices.empty())
+    {
+        auto* voice = mFreeVoices.back();
+        removeFromFreeList(voice);
+        addToActiveList(voice);
+        return voice;
+    }
+
+    if (mOldestVoice == nullptr || !isNoteStealingEnabled())
+        return nullptr;
+
+    // The oldest voice is stolen and becomes the newest
+    auto* voice = mOldestVoice;
+    removeFromActiveList(voice);
+    addToActiveList(voice);
+    return voice;
+}
+
+void MultigrainSynthesiser::releaseFinishedVoices() noexcept
+{
+    for (auto* voice = mOldestVoice; voice != nullptr;)
+    {
+        auto* newerVoice = voice->mNewerVoice;
+        if (!voice->isVoiceActive())
+        {
+            removeFromActiveList(voice);
+            addToFreeList(voice);
+        }
+
+        voice = newerVoice;
+    }
+}
+
+void MultigrainSynthesiser::removeFromFreeList(MultigrainVoice* voice) noexcept
+{
+    const auto index = (size_t) voice->mFreeListIndex;
+    auto* lastVoice = mFreeVoices.back();
+
+    mFreeVoices[index] = lastVoice;
+    lastVoice->mFreeListIndex = (int) index;
+    mFreeVoices.pop_back();
+    voice->mFreeListIndex = -1;
+}
+
+void MultigrainSynthesiser::addToFreeList(MultigrainVoice* voice) noexcept
+{
+    voice->mFreeListIndex = (int) mFreeVoices.size();
+    mFreeVoices.push_back(voice);
+}
+
+void MultigrainSynthesiser::addToActiveList(MultigrainVoice* voice) noexcept
+{
+    voice->mOlderVoice = mNewestVoice;
+    voice->mNewerVoice = nullptr;
+
+    if (mNewestVoice != nullptr)
+        mNewestVoice->mNewerVoice = voice;
+    else
+        mOldestVoice = voice;
+
+    mNewestVoice = voice;
+    mNumActiveVoices++;
+}
+
+void MultigrainSynthesiser::removeFromActiveList(MultigrainVoice* voice) noexcept
+{
+    (voice->mOlderVoice != nullptr ? voice->mOlderVoice->mNewerVoice : mOldestVoice) = voice->mNewerVoice;
+    (voice->mNewerVoice != nullptr ? voice->mNewerVoice->mOlderVoice : mNewestVoice) = voice->mOlderVoice;
+
+    voice->mOlderVoice = nullptr;
+    voice->mNewerVoice = nullptr;
+    mNumActiveVoices--;
+}
+
+void MultigrainSynthesiser::clearActiveList() noexcept
+{
+    while (mOldestVoice != nullptr)
+        removeFromActiveList(mOldestVoice);
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <juce_audio_basics/juce_audio_basics.h>
+
+#include "HalfBandDecimator.h"
+#include "Keymap.h"
+#include "MultigrainSound.h"
+#include "MultigrainVoice.h"
+#include "RenderThreadPool.h"
+
+/**
+ * Synthesiser whose voices are all MultigrainVoices. With a thread pool set, the voices schedule their grains on
+ * the audio thread and render them in parallel on the pool, otherwise they render one after another.
+ *
+ * Playing voices are kept in a list linked through the voices, oldest first, and idle ones on a free list, so
+ * starting, stealing and ending a voice take constant time and idle voices are never visited while rendering.
+ *
+ * When oversampling, the voices run at a multiple of the output rate and their mix is decimated once.
+ */
+class MultigrainSynthesiser : public juce::Synthesiser
+{
+public:
+    /**
+     * Allocates the oversampling buffers and sets the voice rate to sampleRate times the oversampling factor.
+     * Voices must be prepared for getSampleRate() and blocks of samplesPerBlock * kMaxOversamplingFactor samples.
+     */
+    void prepare(double sampleRate, int samplesPerBlock);
+
+    // 1, 2 or 4. A different factor changes the rate of the voices, which ends all notes
+    void setOversamplingFactor(int factor);
+
+    static constexpr int kMaxOversamplingFactor = HalfBandDecimator::kMaxFactor;
+
+    // Delay of the decimator at the current oversampling factor in output samples, may be read from any thread
+    int getLatencySamples() const noexcept { return mLatencySamples.load(std::memory_order_relaxed); }
+
+    // nullptr renders all voices on the audio thread
+    void setThreadPool(RenderThreadPool* threadPool) noexcept { mThreadPool = threadPool; }
+
+    // Number of voices that may play at once, at most the number of voices that were added
+    void setPolyphony(int polyphony) noexcept { mPolyphony = polyphony; }
+
+    // Builds the voice lists, call after adding voices and before rendering. Must not be called from the audio thread
+    void prepareVoiceLists();
+
+    // Empties the voice lists, call before removing voices so that nothing renders them in between
+    void clearVoiceLists();
+
+    /**
+     * The zones new notes play, voices that are playing keep their sound until the note ends.
+     * Audio thread only, the caller keeps the keymap alive. The sounds array of juce::Synthesiser is not used.
+     */
+    void setKeymap(const Keymap* keymap) noexcept { mKeymap = keymap; }
+
+    void noteOn(int midiChannel, int midiNoteNumber, float velocity) override;
+
+protected:
+    void renderVoices(juce::AudioBuffer<float>& outputAudio, int startSample, int numSamples) override;
+
+private:
+    void renderActiveVoices(juce::AudioBuffer<float>& outputAudio, int startSample, int numSamples);
+
+    // Takes a free voice or steals the oldest one once the polyphony is used up
+    MultigrainVoice* allocateVoice();
+
+    // Moves voices whose note has ended from the active to the free list
+    void releaseFinishedVoices() noexcept;
+
+    void removeFromFreeList(MultigrainVoice* voice) noexcept;
+    void addToFreeList(MultigrainVoice* voice) noexcept;
+
+    // The newest voice goes to the end of the active list
+    void addToActiveList(MultigrainVoice* voice) noexcept;
+    void removeFromActiveList(MultigrainVoice* voice) noexcept;
+    void clearActiveList() noexcept;
+
+    //==========================================================================================
+
+    const Keymap* mKeymap = nullptr;
+    RenderThreadPool* mThreadPool = nullptr;
+    int mPolyphony = 1;
+
+    double mOutputSampleRate = 44100.;
+    int mOversamplingFactor = 1;
+    std::atomic<int> mLatencySamples { 0 };
+    juce::AudioBuffer<float> mOversampledBuffer;
+    HalfBandDecimator mDecimator;
+
+    MultigrainVoice* mOldestVoice = nullptr;
+    MultigrainVoice* mNewestVoice = nullptr;
+    int mNumActiveVoices = 0;
+
+    // Reserved for all voices up front, so that adding and removing never allocates on the audio thread
+    std::vector<MultigrainVoice*> mFreeVoices;
+
+    // The active voices of the block the thread pool renders, indexed by its tasks
+    std::vector<MultigrainVoice*> mRenderVoices;
+};
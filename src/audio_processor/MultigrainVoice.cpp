@@ -7,46 +7,51 @@
 // MultigrainVoice
 MultigrainVoice::MultigrainVoice(
     juce::AudioProcessorValueTreeState& apvts, 
-    MultigrainSound& sound
+    GrainPool& grainPool
 ):
         mGrainSpawnPosition{0.},
         mCurrentNoteInHertz{440.},
-        mSamplesTillNextOnset(0),
-        mNextGrainToActivateIndex(0),
         mRootNoteNumberParam(apvts.getRawParameterValue("Root Note")),
         mPositionParam(apvts.getRawParameterValue("Position")),
-        mGrainDurationParam(apvts.getRawParameterValue("Grain Duration")),
-        mNumGrainsParam(apvts.getRawParameterValue("Num Grains")),
-        mGrainSpeedParam(apvts.getRawParameterValue("Grain Speed")),
-        mPositionRandomParam(apvts.getRawParameterValue("Position Random")),
+        mParameters(apvts),
         mAttackParam(apvts.getRawParameterValue("Synth Attack")),
         mDecayParam(apvts.getRawParameterValue("Synth Decay")),
         mSustainParam(apvts.getRawParameterValue("Synth Sustain")),
         mReleaseParam(apvts.getRawParameterValue("Synth Release")),
-        mSound(sound)
+        mRandom((std::uint64_t) juce::Random::getSystemRandom().nextInt64()),
+        mScheduler((std::uint64_t) juce::Random::getSystemRandom().nextInt64()),
+        mGrains(grainPool)
 {
-    // init grain array
-    for(int i = 0; i < 8; i++)
-        mGrains.add(new Grain{sound});
 }
 
 bool MultigrainVoice::canPlaySound(juce::SynthesiserSound* sound)
 {
-    return dynamic_cast<MultigrainSound*>(sound) != nullptr;
+    // MultigrainSynthesiser only ever starts notes of MultigrainSounds, which saves a dynamic_cast
+    return sound != nullptr;
 }
 
 void MultigrainVoice::startNote(int midiNoteNumber, float velocity, juce::SynthesiserSound* s, int /*currentPitchWheelPosition*/)
 {
-    if (auto* sound = dynamic_cast<const MultigrainSound*>(s))
+    jassert(canPlaySound(s));
+    if (canPlaySound(s))
     {
         deactivateGrains();
+        mSound = static_cast<const MultigrainSound*>(s);
+        mGrains.setSound(*mSound);
 
-        mPitchRatio = std::pow(2.0, (midiNoteNumber - (int) *mRootNoteNumberParam) / 12.0)
-                      * sound->sourceSampleRate / getSampleRate();
+        // The zone plays at its original pitch on its own root note, "Root Note" transposes relative to C4
+        const auto transpose = MultigrainSound::kDefaultRootNote - (int) *mRootNoteNumberParam;
+        mPitchRatio = std::pow(2.0, (midiNoteNumber - mSound->midiRootNote + transpose) / 12.0)
+                      * mSound->sourceSampleRate / getSampleRate();
+        mSharedSound.store(mSound, std::memory_order_relaxed);
+
+        // Not the level the previous note of this voice ended on, which would make the new grains the first to be stolen
+        mGrains.setVoiceLevel(1.f);
 
         mCurrentNoteInHertz = juce::MidiMessage::getMidiNoteInHertz(midiNoteNumber);
-        mSamplesTillNextOnset = 0;
-        mGrainSpawnPosition = static_cast<double>(*mPositionParam) * sound->length;
+        mScheduler.reset();
+        mParameters.reset();
+        mGrainSpawnPosition = static_cast<double>(*mPositionParam) * mSound->length;
 
         mLGain = velocity;
         mRGain = velocity;
@@ -78,6 +83,7 @@ void MultigrainVoice::stopNote(float /*velocity*/, bool allowTailOff)
 void MultigrainVoice::killNote()
 {
     clearCurrentNote();
+    mSharedSpawnPosition.store(-1., std::memory_order_relaxed);
     mAdsr.reset();
     deactivateGrains();
 }
@@ -86,131 +92,196 @@ void MultigrainVoice::pitchWheelMoved(int) {}
 
 void MultigrainVoice::controllerMoved(int, int) {}
 
+void MultigrainVoice::setCurrentPlaybackSampleRate(double newRate)
+{
+    juce::SynthesiserVoice::setCurrentPlaybackSampleRate(newRate);
+    mParameters.prepare(newRate);
+}
+
+void MultigrainVoice::prepareToPlay(double sampleRate, int samplesPerBlock)
+{
+    setCurrentPlaybackSampleRate(sampleRate);
+    mGrainBuffer.setSize(2, juce::jmax(1, samplesPerBlock), false, true, false);
+    mEnvelope.calloc((size_t) mGrainBuffer.getNumSamples());
+    mGrains.prepare();
+
+    const auto maxNumOnsets = GrainScheduler::getMaxNumOnsets(juce::jmax(1, samplesPerBlock));
+    mScheduler.prepare(samplesPerBlock);
+    mOnsets.calloc((size_t) maxNumOnsets);
+    mRandom.prepare(maxNumOnsets * kRandomValuesPerGrain);
+}
+
 void MultigrainVoice::renderNextBlock(juce::AudioSampleBuffer& outputBuffer, int startSample, int numSamples)
 {
+    // The host may hand us more samples than announced in prepareToPlay
+    while (numSamples > 0)
+    {
+        auto samplesThisTime = juce::jmin(numSamples, getMaxBlockSize());
+        if (!beginBlock(samplesThisTime))
+            return;
+
+        renderBlock();
+        endBlock(outputBuffer, startSample);
+
+        startSample += samplesThisTime;
+        numSamples -= samplesThisTime;
+    }
+}
+
+bool MultigrainVoice::beginBlock(int numSamples)
+{
+    mBlockSize = 0;
+
     if (!isVoiceActive())
+        return false;
+
+    jassert(numSamples <= getMaxBlockSize());
+    mBlockSize = numSamples;
+
+    // The ADSR returns zero once it has finished, so the whole block can be enveloped in one go
+    for (int i = 0; i < numSamples; i++)
+        mEnvelope[i] = mAdsr.getNextSample();
+
+    // Set before scheduling, which may steal grains. Like grains that fade in, a voice in its attack
+    // counts as loud as it is going to get
+    mGrains.setVoiceLevel(mEnvelope[numSamples - 1] > mEnvelope[0] ? 1.f : mEnvelope[0]);
+
+    // Grains are scheduled with the parameters ramped once per control block, but rendered in one go
+    mParameters.update();
+    for (int offset = 0; offset < numSamples; offset += VoiceParameters::kControlBlockSize)
+    {
+        const auto samplesThisTime = juce::jmin(numSamples - offset, VoiceParameters::kControlBlockSize);
+        scheduleGrains(offset, samplesThisTime, mParameters.getNextSnapshot(samplesThisTime));
+    }
+    mSharedSpawnPosition.store(mGrainSpawnPosition, std::memory_order_relaxed);
+
+    return true;
+}
+
+void MultigrainVoice::renderBlock()
+{
+    if (mBlockSize == 0)
+        return;
+
+    mGrainBuffer.clear(0, mBlockSize);
+    mGrains.renderNextBlock(mGrainBuffer, 0, mBlockSize);
+
+    juce::FloatVectorOperations::multiply(mGrainBuffer.getWritePointer(0), mEnvelope.get(), mBlockSize);
+    juce::FloatVectorOperations::multiply(mGrainBuffer.getWritePointer(1), mEnvelope.get(), mBlockSize);
+}
+
+void MultigrainVoice::endBlock(juce::AudioSampleBuffer& outputBuffer, int startSample)
+{
+    if (mBlockSize == 0)
         return;
 
-    if (auto* playingSound = dynamic_cast<MultigrainSound*> (getCurrentlyPlayingSound().get()))
+    mGrains.releaseFinishedGrains();
+
+    juce::FloatVectorOperations::add(outputBuffer.getWritePointer(0, startSample), mGrainBuffer.getReadPointer(0), mBlockSize);
+    if (outputBuffer.getNumChannels() > 1)
+        juce::FloatVectorOperations::add(outputBuffer.getWritePointer(1, startSample), mGrainBuffer.getReadPointer(1), mBlockSize);
+
+    // Where the voice ends up, for the voices that schedule before this one in the next block
+    mGrains.setVoiceLevel(mEnvelope[mBlockSize - 1] > mEnvelope[0] ? 1.f : mEnvelope[mBlockSize - 1]);
+
+    if (!mAdsr.isActive())
+        killNote();
+}
+
+int MultigrainVoice::getMaxBlockSize() const noexcept
+{
+    return mGrainBuffer.getNumSamples();
+}
+
+void MultigrainVoice::scheduleGrains(int startOffset, int numSamples, const ParameterSnapshot& params)
+{
+    mGrains.setInterpolation(params.interpolation);
+
+    const auto grainDurationSamples = getSampleRate() * params.grainDuration / mCurrentNoteInHertz;
+    // Synchronous onsets spread the grains over their duration, asynchronous ones follow the density in grains per second
+    const auto onsetInterval = params.asynchronousOnsets ? getSampleRate() / (double) params.grainDensity
+                                                         : grainDurationSamples / params.numGrains;
+    const auto numOnsets = mScheduler.getNextOnsets(numSamples, onsetInterval, params.onsetJitter, mOnsets.get());
+
+    // Draw the random values for all grains of this block at once
+    mRandom.fillBatch(numOnsets * kRandomValuesPerGrain);
+
+    // 100 % varies the duration between half and twice the grain period
+    const auto durationRandom = params.grainDurationRandom;
+    // Grains play at their original pitch or the pitch interval, chosen at random
+    const auto intervalRatio = std::pow(2.0, params.grainPitchInterval / 12.0);
+
+    // Unison copies share the onset and position of a grain, spread evenly over the detune and stereo width
+    double unisonRatios[VoiceParameters::kMaxUnison];
+    float unisonPans[VoiceParameters::kMaxUnison];
+    for (int copy = 0; copy < params.unison; copy++)
     {
-        auto numGrains = (int) *mNumGrainsParam;
-        auto grainDurationSamples = getSampleRate() * *mGrainDurationParam / mCurrentNoteInHertz;
-        auto samplesBetweenOnsets = (unsigned int) juce::roundToInt(grainDurationSamples/(float) numGrains);
+        const auto spread = params.unison > 1 ? 2.f * (float) copy / (float) (params.unison - 1) - 1.f : 0.f;
+        unisonRatios[copy] = std::exp2(params.unisonDetune * spread / 1200.0);
+        unisonPans[copy] = params.unisonWidth * spread;
+    }
+    // Keeps the loudness about the same for any number of copies
+    const auto unisonAmplitude = 1.f / std::sqrt((float) params.unison);
 
-        float* outL = outputBuffer.getWritePointer(0, startSample);
-        float* outR = outputBuffer.getNumChannels() > 1 ? outputBuffer.getWritePointer(1, startSample) : nullptr;
+    // New grains start rendering at their onset in the block
+    auto previousOnset = 0;
+    for (int i = 0; i < numOnsets; i++)
+    {
+        updateGrainSpawnPosition(mOnsets[i] - previousOnset, params.grainSpeed);
+        previousOnset = mOnsets[i];
 
-        while (--numSamples >= 0)
+        const auto position = getNextGrainPosition(params.positionRandom, params.positionSnap);
+        const auto durationSamples = juce::roundToInt(grainDurationSamples * std::exp2(durationRandom * mRandom.nextBipolar()));
+        const auto pitchRatio = mRandom.next() < 0.5f ? mPitchRatio : mPitchRatio * intervalRatio;
+
+        // TODO allow randomization of the grain amplitude, on top of the unison compensation
+        for (int copy = 0; copy < params.unison; copy++)
         {
-            if (mSamplesTillNextOnset == 0)
-            {
-                activateNextGrain(getNextGrainPosition(), juce::roundToInt(grainDurationSamples));
-                mSamplesTillNextOnset += samplesBetweenOnsets;
-                updateGrainSpawnPosition(samplesBetweenOnsets);
-            }
-
-            auto voiceOutLeft = 0.f;
-            auto voiceOutRight = 0.f;
-
-            for (Grain* grain : mGrains)
-            {
-                auto grainLeft = 0.f;
-                auto grainRight = 0.f;
-
-                grain->getNextSample(&grainLeft, &grainRight);
-
-                voiceOutLeft += grainLeft;
-                voiceOutRight += grainRight;
-            }
-
-            auto envelopeValue = mAdsr.getNextSample();
-            voiceOutLeft *= envelopeValue;
-            voiceOutRight *= envelopeValue;
-
-            *outL++ += voiceOutLeft;
-            if (outR)
-            {
-                *outR++ += voiceOutRight;
-            }
-            
-            mSamplesTillNextOnset--;
-
-            if (!mAdsr.isActive())
-            {
-                killNote();
-            }
+            mGrains.activateGrain(
+                startOffset + mOnsets[i],
+                durationSamples,
+                position,
+                pitchRatio * unisonRatios[copy],
+                unisonAmplitude,
+                unisonPans[copy],
+                params.windowShape
+            );
         }
-//        // Render all active mGrains
-//        for(Grain* grain : mGrains)
-//            grain->renderNextBlock(outputBuffer, startSample, numSamples);
-//
-//        // Check if new mGrains need to be activated
-//        while (mSamplesTillNextOnset < numSamples)
-//        {
-//            Grain& grain = activateNextGrain(getNextGrainPosition(), juce::roundDoubleToInt(grainDurationSamples));
-//            grain.renderNextBlock(outputBuffer, startSample + mSamplesTillNextOnset, numSamples - mSamplesTillNextOnset);
-//            mSamplesTillNextOnset += samplesBetweenOnsets; // TODO allow randomness here
-//            updateGrainSpawnPosition(samplesBetweenOnsets);
-//        }
-
-//        mSamplesTillNextOnset -= (unsigned int) numSamples;
-
-//        mAdsr.applyEnvelopeToBuffer(outputBuffer, startSample, numSamples);
-        // outputBuffer.applyGain(1/(float) numGrains);
-
-//        if (!mAdsr.isActive())
-//            clearCurrentNote();
     }
+    updateGrainSpawnPosition(numSamples - previousOnset, params.grainSpeed);
 }
 
-Silo& MultigrainVoice::getSilo()
+GrainBank& MultigrainVoice::getGrainBank()
 {
     return this->mGrains;
 }
 
-void MultigrainVoice::updateGrainSpawnPosition(unsigned int samplesBetweenOnsets)
+void MultigrainVoice::updateGrainSpawnPosition(int numSamples, float grainSpeed)
 {
-    mGrainSpawnPosition += (float) samplesBetweenOnsets * *mGrainSpeedParam;
-    mGrainSpawnPosition = std::fmod(mGrainSpawnPosition, mSound.length);
-}
+    const auto length = (double) mSound->length;
+    mGrainSpawnPosition += (float) numSamples * grainSpeed;
 
-GrainPosition MultigrainVoice::getNextGrainPosition()
-{
-    const auto randomRange = *mPositionRandomParam * (float) mSound.length;
-    auto randomDouble = mRandomGenerator.nextDouble();
-    auto nextPosLeft = mGrainSpawnPosition + randomRange * randomDouble - randomRange / 2;
-    randomDouble = mRandomGenerator.nextDouble();
-    auto nextPosRight = mGrainSpawnPosition + randomRange * randomDouble - randomRange / 2;
-    nextPosLeft = std::fmod(nextPosLeft, mSound.length);
-    nextPosRight = std::fmod(nextPosRight, mSound.length);
-    return {nextPosLeft, nextPosRight};
+    // Usually at most one length away, long onset intervals at low notes can be further
+    if (mGrainSpawnPosition >= length || mGrainSpawnPosition < 0.)
+        mGrainSpawnPosition -= length * std::floor(mGrainSpawnPosition / length);
 }
 
-Grain& MultigrainVoice::activateNextGrain(GrainPosition grainPosition, int grainDurationInSamples)
+GrainPosition MultigrainVoice::getNextGrainPosition(float positionRandom, SampleIndex::Snap snap)
 {
-    Grain* grain = mGrains[mNextGrainToActivateIndex];
-#if DEBUG
-    if (grain->isActive)
-    {
-        DBG("Grain voicestealing is happening!");
-        jassertfalse;
-    }
-#endif
-    grain->activate(
-        grainDurationInSamples,
-        grainPosition,
-        mPitchRatio,
-        1.f // TODO allow randomization of this value
-    );
-    mNextGrainToActivateIndex++;
-    if (mNextGrainToActivateIndex == mGrains.size())
-        mNextGrainToActivateIndex = 0;
+    const auto randomRange = positionRandom * (float) mSound->length;
+    auto nextPosLeft = mGrainSpawnPosition + randomRange * (mRandom.next() - 0.5f);
+    auto nextPosRight = mGrainSpawnPosition + randomRange * (mRandom.next() - 0.5f);
+
+    // A binary search in the index that was built when the sample loaded
+    const auto maxSnapDistance = SampleIndex::kMaxSnapSeconds * mSound->getSourceSampleRate();
+    nextPosLeft = mSound->getIndex().snap(nextPosLeft, snap, maxSnapDistance);
+    nextPosRight = mSound->getIndex().snap(nextPosRight, snap, maxSnapDistance);
 
-    return *grain;
+    // The random range is at most the sample length, GrainBank wraps positions that are within one length
+    return {nextPosLeft, nextPosRight};
 }
 
 void MultigrainVoice::deactivateGrains()
 {
-    for(auto* grain : mGrains)
-        grain->isActive = false;
+    mGrains.deactivateGrains();
 }
\ No newline at end of file
@@ -9,11 +9,11 @@
 #include <juce_audio_processors/juce_audio_processors.h>
 
 #include "MultigrainSound.h"
-#include "Grain.h"
+#include "GrainBank.h"
 #include "GrainPosition.h"
-
-// Stores grains
-using Silo = juce::OwnedArray<Grain>;
+#include "GrainRandom.h"
+#include "GrainScheduler.h"
+#include "VoiceParameters.h"
 
 /**
  * Manages and schedules mGrains;
@@ -21,7 +21,8 @@ using Silo = juce::OwnedArray<Grain>;
 class MultigrainVoice : public juce::SynthesiserVoice
 {
 public:
-    MultigrainVoice(juce::AudioProcessorValueTreeState &apvts, MultigrainSound &sound);
+    // Voices live as long as the synth, the sound they play is the one handed to startNote
+    MultigrainVoice(juce::AudioProcessorValueTreeState &apvts, GrainPool &grainPool);
     ~MultigrainVoice() override = default;
 
     bool canPlaySound(juce::SynthesiserSound *sound) override;
@@ -43,13 +44,44 @@ public:
         int numSamples
     ) override;
 
-    Silo& getSilo();
+    // Changes the rate at which the grains are rendered, the oversampling mode of the synth raises it
+    void setCurrentPlaybackSampleRate(double newRate) override;
+
+    // Allocates the scratch buffer and the grains, must not be called from the audio thread
+    void prepareToPlay(double sampleRate, int samplesPerBlock);
+
+    /**
+     * renderNextBlock in three steps, so that the grains of several voices can be rendered in parallel.
+     * beginBlock schedules the grains of the next numSamples samples and returns false if the voice is silent,
+     * in which case the other two do nothing. renderBlock renders the grains into the scratch buffer of this voice
+     * and may run on any thread.
+     * endBlock adds the scratch buffer to outputBuffer and ends the note if the envelope has finished.
+     * beginBlock and endBlock touch the grain pool shared by all voices and must run on the audio thread.
+     */
+    bool beginBlock(int numSamples);
+    void renderBlock();
+    void endBlock(juce::AudioSampleBuffer& outputBuffer, int startSample);
+
+    // Longest block beginBlock accepts
+    int getMaxBlockSize() const noexcept;
+
+    GrainBank& getGrainBank();
+
+    // Where the next grains spawn, in samples of the sound that is playing. -1 while the voice is silent
+    double getSpawnPosition() const noexcept { return mSharedSpawnPosition.load(std::memory_order_relaxed); }
+
+    // The sound the spawn position belongs to, only to be compared with, the sound may be gone already
+    const MultigrainSound* getSpawnSound() const noexcept { return mSharedSound.load(std::memory_order_relaxed); }
+
+    // Upper limit of the "Num Grains" parameter
+    static constexpr int kMaxNumGrains = 256;
 
 private:
-    juce::Random mRandomGenerator;
-    Grain &activateNextGrain(GrainPosition grainPosition, int grainDurationInSamples);
-    void updateGrainSpawnPosition(unsigned int samplesBetweenOnsets);
-    GrainPosition getNextGrainPosition();
+    friend class MultigrainSynthesiser;
+
+    void updateGrainSpawnPosition(int numSamples, float grainSpeed);
+    GrainPosition getNextGrainPosition(float positionRandom, SampleIndex::Snap snap);
+    void scheduleGrains(int startOffset, int numSamples, const ParameterSnapshot& params);
     void deactivateGrains();
     void killNote();
 
@@ -58,21 +90,19 @@ private:
     double mPitchRatio = 0;
     double mSourceSamplePosition = 0;
     double mGrainSpawnPosition;
+    // Copy of mGrainSpawnPosition for other threads, updated every block
+    std::atomic<double> mSharedSpawnPosition { -1. };
+    std::atomic<const MultigrainSound*> mSharedSound { nullptr };
 
     float mLGain = 0;
     float mRGain = 0;
 
     double mCurrentNoteInHertz;
 
-    unsigned int mSamplesTillNextOnset;
-    unsigned int mNextGrainToActivateIndex;
-
     std::atomic<float>* mRootNoteNumberParam;
     std::atomic<float>* mPositionParam;
-    std::atomic<float>* mGrainDurationParam;
-    std::atomic<float>* mNumGrainsParam;
-    std::atomic<float>* mGrainSpeedParam;
-    std::atomic<float>* mPositionRandomParam;
+
+    VoiceParameters mParameters;
 
     std::atomic<float>* mAttackParam;
     std::atomic<float>* mDecayParam;
@@ -82,9 +112,27 @@ private:
 
     juce::ADSR mAdsr;
 
-    Silo mGrains;
+    // Every grain draws left and right position, duration and pitch
+    static constexpr int kRandomValuesPerGrain = 4;
+    GrainRandom mRandom;
+
+    GrainScheduler mScheduler;
+    juce::HeapBlock<int> mOnsets;
+
+    GrainBank mGrains;
+    juce::AudioSampleBuffer mGrainBuffer;
+    juce::HeapBlock<float> mEnvelope;
+    int mBlockSize = 0;
+
+    // The sound of the current note, kept alive by the reference juce::SynthesiserVoice holds
+    const MultigrainSound* mSound = nullptr;
+
+    // Position in the free list of MultigrainSynthesiser, -1 while the voice is in use
+    int mFreeListIndex = -1;
 
-    MultigrainSound &mSound;
+    // Neighbours in the active list of MultigrainSynthesiser, which runs from the oldest to the newest note
+    MultigrainVoice* mOlderVoice = nullptr;
+    MultigrainVoice* mNewerVoice = nullptr;
 
     JUCE_LEAK_DETECTOR(MultigrainVoice)
 };
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "./PluginProcessor.h"
 #include "../ui/PluginEditor.h"
+#include "./GrainWindows.h"
 
 //==============================================================================
 MultigrainAudioProcessor::MultigrainAudioProcessor()
@@ -19,6 +20,7 @@ MultigrainAudioProcessor::MultigrainAudioProcessor()
 
 MultigrainAudioProcessor::~MultigrainAudioProcessor()
 {
+    cancelPendingUpdate();
 }
 
 //==============================================================================
@@ -94,6 +96,8 @@ void MultigrainAudioProcessor::prepareToPlay (double sampleRate, int samplesPerB
     juce::ignoreUnused (sampleRate, samplesPerBlock);
 
     synthAudioSource.prepareToPlay(samplesPerBlock, sampleRate);
+    sampleLoader.setHostSampleRate(sampleRate);
+    setLatencySamples(synthAudioSource.getLatencySamples());
     reverb.setSampleRate(sampleRate);
 }
 
@@ -153,6 +157,15 @@ void MultigrainAudioProcessor::processBlock(
         reverb.processStereo(outL, outR, buffer.getNumSamples());
 
     buffer.applyGain(*masterGain);
+
+    // The host is told from the message thread, "Oversampling" may have changed during this block
+    if (synthAudioSource.getLatencySamples() != getLatencySamples())
+        triggerAsyncUpdate();
+}
+
+void MultigrainAudioProcessor::handleAsyncUpdate()
+{
+    setLatencySamples(synthAudioSource.getLatencySamples());
 }
 
 //==============================================================================
@@ -209,11 +222,37 @@ MultigrainAudioProcessor::createParameterLayout()
             "Num Grains",
             "Num Grains",
             1,
-            8,
+            MultigrainVoice::kMaxNumGrains,
             1
         )
     );
 
+    // Synchronous onsets are spread evenly over the grain duration by Num Grains, asynchronous onsets follow Grain Density
+    theLayout.add(
+        std::make_unique<juce::AudioParameterChoice>(
+            "Onset Mode",
+            "Onset Mode",
+            juce::StringArray { "Synchronous", "Asynchronous" },
+            0
+        )
+    );
+
+    // Grains per second in the asynchronous onset mode
+    theLayout.add(
+        std::make_unique<juce::AudioParameterFloat>(
+            "Grain Density",
+            "Density",
+            juce::NormalisableRange<float>(.1f, 2000.f, .0001f, .2f),
+            20.f
+        )
+    );
+
+    // Moves every onset randomly by up to one onset interval in either direction
+    theLayout.add(std::make_unique<juce::AudioParameterFloat>("Onset Jitter",
+                                                           "Onset Jitter",
+                                                           juce::NormalisableRange<float>(0.f, 1.f, .0001f, 1.f),
+                                                           0.f));
+
     // Increases the grain period by a factor ranging from 1 to 1000
     theLayout.add(
         std::make_unique<juce::AudioParameterFloat>(
@@ -237,6 +276,25 @@ MultigrainAudioProcessor::createParameterLayout()
                                                          12,
                                                          0));
 
+    // Number of detuned copies of every grain, they share onsets and positions
+    theLayout.add(std::make_unique<juce::AudioParameterInt>("Unison",
+                                                         "Unison",
+                                                         1,
+                                                         VoiceParameters::kMaxUnison,
+                                                         1));
+
+    // Pitch distance in cents between the lowest and the centre unison copy
+    theLayout.add(std::make_unique<juce::AudioParameterFloat>("Unison Detune",
+                                                           "Detune",
+                                                           juce::NormalisableRange<float>(0.f, 100.f, .01f, 1.f),
+                                                           15.f));
+
+    // Spreads the unison copies over the stereo field
+    theLayout.add(std::make_unique<juce::AudioParameterFloat>("Unison Width",
+                                                           "Width",
+                                                           juce::NormalisableRange<float>(0.f, 1.f, .0001f, 1.f),
+                                                           1.f));
+
     // Allows to set a scale in which the mGrains are played randomly
     // layout.add(std::make_unique<juce::AudioParameterChoice>("Grain Pitch Random",
     //                                                         "Pitch Scale",
@@ -280,20 +338,84 @@ MultigrainAudioProcessor::createParameterLayout()
                                                            juce::NormalisableRange<float>(0.f, 1.f, .0001f, .2f),
                                                            0.f));
 
+    // Moves the start of every grain to the closest zero crossing or onset of the sample, in the order of SampleIndex::Snap
+    theLayout.add(std::make_unique<juce::AudioParameterChoice>("Position Snap",
+                                                            "Position Snap",
+                                                            juce::StringArray { "Off", "Zero Crossings", "Onsets" },
+                                                            0));
+
     theLayout.add(std::make_unique<juce::AudioParameterFloat>("Grain Speed",
                                                            "Speed",
                                                            juce::NormalisableRange<float>(-2.f, 2.f, .0001f, 1.f),
                                                            0.f));
 
-    juce::StringArray grainShapeChoices;
-    grainShapeChoices.add("Triangle");
-    grainShapeChoices.add("Hanning");
     // Sets the shape of the grain envelope
     theLayout.add(
         std::make_unique<juce::AudioParameterChoice>(
             "Grain Envelope Shape",
             "Shape",
-            grainShapeChoices,
+            GrainWindows::getShapeNames(),
+            0
+        )
+    );
+
+    // Total number of grains over all voices, the quietest grains are stolen beyond that
+    theLayout.add(
+        std::make_unique<juce::AudioParameterInt>(
+            "Grain Budget",
+            "Grain Budget",
+            16,
+            GrainPool::kMaxNumGrains,
+            1024
+        )
+    );
+
+    // Number of notes that can play at once, the oldest note is stolen beyond that
+    theLayout.add(
+        std::make_unique<juce::AudioParameterInt>(
+            "Polyphony",
+            "Polyphony",
+            1,
+            SynthAudioSource::kMaxNumVoices,
+            16
+        )
+    );
+
+    // Renders the grains at a multiple of the sample rate against aliasing of high transpositions, for final bounces
+    theLayout.add(
+        std::make_unique<juce::AudioParameterChoice>(
+            "Oversampling",
+            "Oversampling",
+            juce::StringArray { "Off", "2x", "4x" },
+            0
+        )
+    );
+
+    // Renders the voices on worker threads, one busy instance can then use more than one core
+    theLayout.add(std::make_unique<juce::AudioParameterBool>("Parallel Voices",
+                                                          "Parallel Voices",
+                                                          false));
+
+    // Keeps newly loaded samples as 16 bit integers, which halves their memory and the bandwidth per grain
+    theLayout.add(std::make_unique<juce::AudioParameterBool>("Compact Samples",
+                                                          "Compact Samples",
+                                                          false));
+
+    // Converts newly loaded samples to the host rate, so they are only interpolated when transposed
+    theLayout.add(std::make_unique<juce::AudioParameterBool>("Resample To Host Rate",
+                                                          "Resample To Host Rate",
+                                                          false));
+
+    juce::StringArray interpolationChoices;
+    interpolationChoices.add("Linear");
+    interpolationChoices.add("Hermite");
+    interpolationChoices.add("Sinc");
+    // Quality of the sample interpolation, in the order of GrainKernels::Interpolation. Higher is more expensive
+    theLayout.add(
+        std::make_unique<juce::AudioParameterChoice>(
+            "Interpolation",
+            "Interpolation",
+            interpolationChoices,
             0
         )
     );
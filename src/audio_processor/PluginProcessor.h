@@ -3,10 +3,12 @@
 #include <juce_audio_processors/juce_audio_processors.h>
 #include <juce_audio_basics/juce_audio_basics.h>
 
+#include "SampleLoader.h"
 #include "SynthAudioSource.h"
 
 //==============================================================================
-class MultigrainAudioProcessor  : public juce::AudioProcessor
+class MultigrainAudioProcessor  : public juce::AudioProcessor,
+                                  private juce::AsyncUpdater
 {
 public:
     //==============================================================================
@@ -49,11 +51,16 @@ public:
     juce::AudioProcessorValueTreeState apvts {*this, nullptr, "Parameters", createParameterLayout()};
 
     SynthAudioSource& getSynthAudioSource();
+    SampleLoader& getSampleLoader() noexcept { return sampleLoader; }
     juce::MidiKeyboardState keyboardState;
 
 private:
+    // Reports the latency of the oversampling to the host once it has changed
+    void handleAsyncUpdate() override;
+
     //==============================================================================
     SynthAudioSource synthAudioSource;
+    SampleLoader sampleLoader { synthAudioSource, apvts };
     std::atomic<float>* masterGain;
     std::atomic<float>* applyReverb;
     juce::Reverb reverb;
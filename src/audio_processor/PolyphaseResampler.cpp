@@ -0,0 +1,103 @@
+#include "./PolyphaseResampler.h"
+
+#include <numeric>
+
+PolyphaseResampler::PolyphaseResampler(double sourceSampleRate, double targetSampleRate)
+{
+    jassert(sourceSampleRate > 0. && targetSampleRate > 0.);
+
+    // Sample rates are whole numbers in practice, which keeps the common ratios like 160 / 147 exact
+    const auto sourceRate = juce::jmax((juce::int64) 1, (juce::int64) std::llround(sourceSampleRate));
+    const auto targetRate = juce::jmax((juce::int64) 1, (juce::int64) std::llround(targetSampleRate));
+    const auto divisor = std::gcd(sourceRate, targetRate);
+
+    auto upFactor = targetRate / divisor;
+    auto downFactor = sourceRate / divisor;
+    if (upFactor > kMaxNumPhases)
+    {
+        downFactor = juce::jmax((juce::int64) 1, (juce::int64) std::llround((double) sourceRate * kMaxNumPhases / (double) targetRate));
+        upFactor = kMaxNumPhases;
+    }
+
+    mUpFactor = (int) upFactor;
+    mDownFactor = (int) downFactor;
+    mOutputSampleRate = sourceSampleRate * (double) mUpFactor / (double) mDownFactor;
+
+    // Equal rates are copied
+    if (mUpFactor == mDownFactor)
+    {
+        mUpFactor = mDownFactor = 1;
+        mCoefficients.calloc(1);
+        mCoefficients[0] = 1.f;
+        return;
+    }
+
+    // Cutoff in cycles per input sample, a little below the lower of the two Nyquist frequencies
+    const auto ratio = (double) mUpFactor / (double) mDownFactor;
+    const auto cutoff = 0.45 * juce::jmin(1., ratio);
+    mNumTaps = 2 * (int) std::ceil(kNumZeroCrossings * juce::jmax(1., 1. / ratio));
+
+    const auto pi = juce::MathConstants<double>::pi;
+    const auto halfWidth = 0.5 * mNumTaps;
+    mCoefficients.calloc((size_t) mUpFactor * (size_t) mNumTaps);
+
+    for (int phase = 0; phase < mUpFactor; phase++)
+    {
+        auto* coefficients = mCoefficients + (size_t) phase * (size_t) mNumTaps;
+        auto sum = 0.;
+
+        // Tap k weighs input sample i + mNumTaps / 2 - k for output samples that lie phase / mUpFactor behind i
+        for (int k = 0; k < mNumTaps; k++)
+        {
+            const auto x = (double) phase / (double) mUpFactor + (double) (k - mNumTaps / 2);
+            const auto sinc = x == 0. ? 2. * cutoff : std::sin(2. * pi * cutoff * x) / (pi * x);
+            const auto window = std::abs(x) >= halfWidth
+                                    ? 0.
+                                    : 0.42 + 0.5 * std::cos(pi * x / halfWidth) + 0.08 * std::cos(2. * pi * x / halfWidth);
+            coefficients[k] = (float) (sinc * window);
+            sum += sinc * window;
+        }
+
+        // Every phase passes DC unchanged, so no ripple at the output rate
+        for (int k = 0; k < mNumTaps; k++)
+            coefficients[k] = (float) (coefficients[k] / sum);
+    }
+}
+
+juce::int64 PolyphaseResampler::getOutputLength(int numInputSamples) const noexcept
+{
+    return ((juce::int64) numInputSamples * mUpFactor + mDownFactor - 1) / mDownFactor;
+}
+
+void PolyphaseResampler::process(const float* input, int numInputSamples, float* output, int startOutputSample, int numOutputSamples) const noexcept
+{
+    const auto halfTaps = mNumTaps / 2;
+
+    for (int i = 0; i < numOutputSamples; i++)
+    {
+        const auto position = (juce::int64) (startOutputSample + i) * mDownFactor;
+        const auto phase = (int) (position % mUpFactor);
+        const auto first = (int) (position / mUpFactor) + halfTaps - (mNumTaps - 1);
+        const auto* coefficients = mCoefficients + (size_t) phase * (size_t) mNumTaps + (mNumTaps - 1);
+
+        auto sum = 0.f;
+        if (first >= 0 && first + mNumTaps <= numInputSamples)
+        {
+            for (int k = 0; k < mNumTaps; k++)
+                sum += *(coefficients - k) * input[first + k];
+        }
+        else
+        {
+            for (int k = 0; k < mNumTaps; k++)
+            {
+                auto index = (first + k) % numInputSamples;
+                if (index < 0)
+                    index += numInputSamples;
+
+                sum += *(coefficients - k) * input[index];
+            }
+        }
+
+        output[i] = sum;
+    }
+}
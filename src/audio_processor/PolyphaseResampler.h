@@ -0,0 +1,46 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+/**
+ * Blackman windowed sinc resampler in polyphase form, for converting whole samples between two rates off the
+ * audio thread. The ratio of the rates is reduced to upFactor / downFactor and the lowpass is split into upFactor
+ * phases, every output sample is one dot product of a phase with the input around it.
+ *
+ * The input is treated as looping, like the guard samples of SampleStorage, so both ends are filtered the same.
+ */
+class PolyphaseResampler
+{
+public:
+    PolyphaseResampler(double sourceSampleRate, double targetSampleRate);
+
+    /**
+     * The rate of the output. Equals the target rate unless the exact ratio would take more than kMaxNumPhases
+     * phases, then the closest ratio that does not is used.
+     */
+    double getOutputSampleRate() const noexcept { return mOutputSampleRate; }
+
+    juce::int64 getOutputLength(int numInputSamples) const noexcept;
+
+    /**
+     * Writes numOutputSamples output samples, starting at output sample startOutputSample, of the input that is
+     * numInputSamples long. Output samples can be computed in any order, so long inputs can be converted in chunks.
+     */
+    void process(const float* input, int numInputSamples, float* output, int startOutputSample, int numOutputSamples) const noexcept;
+
+    static constexpr int kMaxNumPhases = 1024;
+
+private:
+    // Zero crossings of the sinc on either side when upsampling, downsampling widens the filter by the ratio
+    static constexpr int kNumZeroCrossings = 16;
+
+    int mUpFactor = 1;
+    int mDownFactor = 1;
+    int mNumTaps = 1;
+    double mOutputSampleRate;
+
+    // mNumTaps coefficients per phase, phase after phase
+    juce::HeapBlock<float> mCoefficients;
+
+    JUCE_DECLARE_NON_COPYABLE(PolyphaseResampler)
+};
@@ -0,0 +1,149 @@
+#include "./RenderThreadPool.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_IX86)
+ #include <emmintrin.h>
+#endif
+
+namespace
+{
+    constexpr std::uint64_t kBatchShift = 48;
+    constexpr std::uint64_t kNumJobsShift = 32;
+    constexpr std::uint64_t kMaxNumJobs = 0xffff;
+
+    // Some tens of microseconds of polling before an idle worker of an active pool parks
+    constexpr int kSpinsBeforeSleep = 1000;
+
+    std::uint64_t getBatch(std::uint64_t work) { return work >> kBatchShift; }
+
+    // Tells the core that this is a spin loop, without giving up the time slice
+    inline void spinPause() noexcept
+    {
+       #if defined(__SSE2__) || defined(_M_X64) || defined(_M_IX86)
+        _mm_pause();
+       #elif defined(_M_ARM64)
+        __yield();
+       #elif defined(__aarch64__) || defined(__arm__)
+        __asm__ __volatile__ ("yield");
+       #endif
+    }
+}
+
+class RenderThreadPool::Worker : public juce::Thread
+{
+public:
+    explicit Worker(RenderThreadPool& pool)
+        : juce::Thread("Multigrain Render Worker"),
+          mPool(pool)
+    {
+    }
+
+    void run() override
+    {
+        auto batch = getBatch(mPool.mWork.load(std::memory_order_acquire));
+        auto numSpins = 0;
+
+        while (!threadShouldExit())
+        {
+            const auto nextBatch = getBatch(mPool.mWork.load(std::memory_order_acquire));
+            if (nextBatch != batch)
+            {
+                batch = nextBatch;
+                numSpins = 0;
+                while (mPool.runNextJob()) {}
+            }
+            else if (++numSpins < kSpinsBeforeSleep && mPool.mActive.load(std::memory_order_relaxed))
+            {
+                spinPause();
+            }
+            else
+            {
+                // The audio thread only posts if it sees us counted, so check for a batch again after counting.
+                // A post between reading the wake count and waiting makes the wait return straight away
+                const auto wakeCount = mPool.mWakeCount.load(std::memory_order_acquire);
+                mPool.mNumSleeping.fetch_add(1, std::memory_order_seq_cst);
+
+                if (getBatch(mPool.mWork.load(std::memory_order_seq_cst)) == batch && !threadShouldExit())
+                    mPool.mWakeCount.wait(wakeCount, std::memory_order_acquire);
+
+                mPool.mNumSleeping.fetch_sub(1, std::memory_order_relaxed);
+                numSpins = 0;
+            }
+        }
+    }
+
+private:
+    RenderThreadPool& mPool;
+};
+
+RenderThreadPool::RenderThreadPool(int numWorkers)
+    : mNumWorkers(numWorkers)
+{
+}
+
+RenderThreadPool::~RenderThreadPool()
+{
+    for (auto* worker : mWorkers)
+        worker->signalThreadShouldExit();
+
+    mWakeCount.fetch_add(1, std::memory_order_release);
+    mWakeCount.notify_all();
+
+    for (auto* worker : mWorkers)
+        worker->stopThread(1000);
+}
+
+void RenderThreadPool::start()
+{
+    if (isRunning())
+        return;
+
+    for (int i = 0; i < mNumWorkers; i++)
+    {
+        auto* worker = mWorkers.add(new Worker(*this));
+        worker->startRealtimeThread(juce::Thread::RealtimeOptions{});
+    }
+
+    mRunning.store(true, std::memory_order_release);
+}
+
+void RenderThreadPool::run(int numJobs, Job job, void* context) noexcept
+{
+    jassert(numJobs >= 0 && (std::uint64_t) numJobs <= kMaxNumJobs);
+    if (numJobs <= 0)
+        return;
+
+    mJob = job;
+    mContext = context;
+    mNumJobsDone.store(0, std::memory_order_relaxed);
+
+    // Publishing the new batch also publishes the job, no worker can still be busy with the previous one
+    const auto batch = (getBatch(mWork.load(std::memory_order_relaxed)) + 1) & 0xffff;
+    mWork.store((batch << kBatchShift) | ((std::uint64_t) numJobs << kNumJobsShift), std::memory_order_seq_cst);
+
+    // A futex wake or its equivalent, which never blocks. Workers that are spinning see the batch by themselves
+    if (mNumSleeping.load(std::memory_order_seq_cst) > 0)
+    {
+        mWakeCount.fetch_add(1, std::memory_order_release);
+        mWakeCount.notify_all();
+    }
+
+    while (runNextJob()) {}
+
+    // The workers are finishing the last jobs, which takes less than a time slice
+    while (mNumJobsDone.load(std::memory_order_acquire) < numJobs)
+        spinPause();
+}
+
+bool RenderThreadPool::runNextJob() noexcept
+{
+    const auto work = mWork.fetch_add(1, std::memory_order_acq_rel);
+    const auto jobIndex = (int) (work & 0xffffffff);
+    const auto numJobs = (int) ((work >> kNumJobsShift) & kMaxNumJobs);
+
+    if (jobIndex >= numJobs)
+        return false;
+
+    mJob(mContext, jobIndex);
+    mNumJobsDone.fetch_add(1, std::memory_order_release);
+    return true;
+}
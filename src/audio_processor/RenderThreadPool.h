@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <juce_core/juce_core.h>
+
+/**
+ * A fixed set of realtime worker threads that help the audio thread with a batch of independent jobs.
+ *
+ * The threads are only started by start(), the first time they are needed. Handing out jobs and waiting for them
+ * only uses atomics, the audio thread never takes a lock. While the pool is active, workers that run out of jobs
+ * spin for a short while in case the next batch follows soon, then they park on an atomic wait (a futex or its
+ * equivalent). The audio thread only posts to it when a worker is parked. The jobs of a batch that come before
+ * the workers are awake are run by the calling thread.
+ */
+class RenderThreadPool
+{
+public:
+    using Job = void (*)(void* context, int jobIndex);
+
+    explicit RenderThreadPool(int numWorkers);
+    ~RenderThreadPool();
+
+    // Starts the workers if they are not running yet, must not be called from the audio thread
+    void start();
+    bool isRunning() const noexcept { return mRunning.load(std::memory_order_acquire); }
+
+    int getNumWorkers() const noexcept { return mNumWorkers; }
+
+    // Lets workers spin between batches instead of parking straight away. Can be called from the audio thread
+    void setActive(bool shouldBeActive) noexcept { mActive.store(shouldBeActive, std::memory_order_relaxed); }
+
+    // Calls job(context, i) for every i in [0, numJobs) on the workers and the calling thread, returns when all are done
+    void run(int numJobs, Job job, void* context) noexcept;
+
+private:
+    class Worker;
+
+    // Takes one job of the current batch and runs it, returns false once all of them are taken
+    bool runNextJob() noexcept;
+
+    //==========================================================================================
+
+    // Batch number in the upper 16 bits, number of jobs in the middle 16 and the next job to take in the lower 32.
+    // Packing them lets a worker take a job and learn whether it belongs to the current batch in one atomic step.
+    std::atomic<std::uint64_t> mWork { 0 };
+    std::atomic<int> mNumJobsDone { 0 };
+    std::atomic<bool> mActive { false };
+
+    // Parked workers wait for mWakeCount to change
+    std::atomic<int> mNumSleeping { 0 };
+    std::atomic<std::uint32_t> mWakeCount { 0 };
+
+    Job mJob = nullptr;
+    void* mContext = nullptr;
+
+    const int mNumWorkers;
+    std::atomic<bool> mRunning { false };
+    juce::OwnedArray<Worker> mWorkers;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(RenderThreadPool)
+};
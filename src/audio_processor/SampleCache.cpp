@@ -0,0 +1,94 @@
+#include "./SampleCache.h"
+
+namespace
+{
+    // FNV-1a over 64 bit words, fast enough to not hold up a load and plenty against accidental collisions
+    juce::String hashFile(const juce::File& file)
+    {
+        juce::FileInputStream stream (file);
+        if (!stream.openedOk())
+            return {};
+
+        constexpr int kNumWords = 8192;
+        juce::HeapBlock<std::uint64_t> words (kNumWords);
+        auto hash = (std::uint64_t) 0xcbf29ce484222325ull;
+
+        for (;;)
+        {
+            const auto numBytes = stream.read(words.get(), kNumWords * (int) sizeof(std::uint64_t));
+            if (numBytes <= 0)
+                break;
+
+            // The tail of the last block is zero padded, the file size is part of the hash anyway
+            const auto numWords = (numBytes + (int) sizeof(std::uint64_t) - 1) / (int) sizeof(std::uint64_t);
+            std::memset(reinterpret_cast<char*>(words.get()) + numBytes, 0, (size_t) (numWords * (int) sizeof(std::uint64_t) - numBytes));
+
+            for (int i = 0; i < numWords; i++)
+                hash = (hash ^ words[i]) * 0x100000001b3ull;
+        }
+
+        return juce::String::toHexString((juce::int64) hash) + "-" + juce::String(file.getSize());
+    }
+}
+
+juce::String SampleCache::getContentHash(const juce::File& file)
+{
+    const auto path = file.getFullPathName();
+    const auto size = file.getSize();
+    const auto modificationTime = file.getLastModificationTime();
+
+    {
+        const juce::ScopedLock sl (mLock);
+        const auto known = mFileHashes.find(path);
+        if (known != mFileHashes.end() && known->second.size == size && known->second.modificationTime == modificationTime)
+            return known->second.contentHash;
+    }
+
+    // Hashed without holding the lock, other instances may look up other files meanwhile
+    const auto contentHash = hashFile(file);
+    if (contentHash.isNotEmpty())
+    {
+        const juce::ScopedLock sl (mLock);
+        mFileHashes[path] = { size, modificationTime, contentHash };
+    }
+
+    return contentHash;
+}
+
+SampleCache::Sample SampleCache::find(const juce::String& contentHash, GrainKernels::SampleFormat format, double targetSampleRate)
+{
+    const juce::ScopedLock sl (mLock);
+
+    const auto entry = mEntries.find(getKey(contentHash, format, targetSampleRate));
+    if (entry == mEntries.end())
+        return {};
+
+    // The sounds hold both, so they expire together
+    return { entry->second.storage.lock(), entry->second.index.lock(), entry->second.sampleRate };
+}
+
+SampleCache::Sample SampleCache::add(const juce::String& contentHash, GrainKernels::SampleFormat format, double targetSampleRate,
+                                     Sample sample)
+{
+    const juce::ScopedLock sl (mLock);
+    removeExpiredEntries();
+
+    auto& entry = mEntries[getKey(contentHash, format, targetSampleRate)];
+    if (auto existing = entry.storage.lock())
+        return { existing, entry.index.lock(), entry.sampleRate };
+
+    entry = { sample.storage, sample.index, sample.sampleRate };
+    return sample;
+}
+
+juce::String SampleCache::getKey(const juce::String& contentHash, GrainKernels::SampleFormat format, double targetSampleRate)
+{
+    return contentHash + (format == GrainKernels::SampleFormat::int16 ? ":int16:" : ":float32:")
+           + juce::String((juce::int64) std::llround(targetSampleRate));
+}
+
+void SampleCache::removeExpiredEntries()
+{
+    for (auto entry = mEntries.begin(); entry != mEntries.end();)
+        entry = entry->second.storage.expired() ? mEntries.erase(entry) : std::next(entry);
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <juce_core/juce_core.h>
+
+#include "SampleIndex.h"
+#include "SampleStorage.h"
+
+/**
+ * Decoded samples shared by all plugin instances in the process, keyed by a hash of the file contents, the
+ * sample format and the rate the sample was resampled to. Entries only hold weak references, a sample is freed once the last sound that plays it is gone.
+ *
+ * Use it through a juce::SharedResourcePointer. All functions may be called from any thread but the audio thread.
+ */
+class SampleCache
+{
+public:
+    struct Sample
+    {
+        std::shared_ptr<const SampleStorage> storage;
+        std::shared_ptr<const SampleIndex> index;
+        double sampleRate = 0.;
+    };
+
+    /**
+     * Hash of the contents of file, empty if it cannot be read. Reads the whole file the first time,
+     * after that the hash is remembered as long as the size and modification time of the file stay the same.
+     */
+    juce::String getContentHash(const juce::File& file);
+
+    /**
+     * The sample decoded from contents with contentHash and resampled to targetSampleRate, no storage if there
+     * is none. A targetSampleRate of 0 stands for the sample rate of the file.
+     */
+    Sample find(const juce::String& contentHash, GrainKernels::SampleFormat format, double targetSampleRate);
+
+    // Adds sample unless another thread added the same one first, returns the sample that is in the cache
+    Sample add(const juce::String& contentHash, GrainKernels::SampleFormat format, double targetSampleRate, Sample sample);
+
+private:
+    struct Entry
+    {
+        std::weak_ptr<const SampleStorage> storage;
+        std::weak_ptr<const SampleIndex> index;
+        double sampleRate = 0.;
+    };
+
+    struct FileIdentity
+    {
+        juce::int64 size = 0;
+        juce::Time modificationTime;
+        juce::String contentHash;
+    };
+
+    static juce::String getKey(const juce::String& contentHash, GrainKernels::SampleFormat format, double targetSampleRate);
+
+    // Drops the entries whose samples have been freed
+    void removeExpiredEntries();
+
+    //==========================================================================================
+
+    juce::CriticalSection mLock;
+    std::map<juce::String, Entry> mEntries;
+    std::map<juce::String, FileIdentity> mFileHashes;
+};
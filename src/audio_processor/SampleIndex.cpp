@@ -0,0 +1,169 @@
+#include "./SampleIndex.h"
+
+namespace
+{
+    // Length of the frames the onset detection compares
+    constexpr double kHopSeconds = 0.005;
+
+    // Onsets closer together than this are one onset
+    constexpr double kMinOnsetSpacingSeconds = 0.05;
+
+    // The detection function is compared with its average over this long on either side
+    constexpr double kThresholdSeconds = 0.2;
+
+    // How far the log energy of a frame has to rise above that average, about 6 dB
+    constexpr float kThresholdRise = 1.4f;
+
+    // Mean square energy below which a frame counts as silent, about -70 dBFS
+    constexpr float kSilence = 1.0e-7f;
+
+    // Samples analysed between two checks whether to stop
+    constexpr int kBlockSize = 1 << 16;
+}
+
+std::shared_ptr<const SampleIndex> SampleIndex::create(const SampleStorage& storage, double sampleRate,
+                                                       const std::function<bool()>& shouldStop)
+{
+    std::shared_ptr<SampleIndex> index (new SampleIndex());
+
+    const auto finished = storage.getFormat() == GrainKernels::SampleFormat::int16
+                              ? index->analyse<std::int16_t>(storage, sampleRate, shouldStop)
+                              : index->analyse<float>(storage, sampleRate, shouldStop);
+
+    return finished ? index : nullptr;
+}
+
+double SampleIndex::snap(double position, Snap snap, double maxDistance) const noexcept
+{
+    const auto& positions = snap == Snap::onsets ? mOnsets : mZeroCrossings;
+    if (snap == Snap::off || positions.empty())
+        return position;
+
+    // The neighbours on either side, the ones across the end of the sample when there is none in between
+    const auto next = std::lower_bound(positions.begin(), positions.end(), position);
+    const auto after = next != positions.end() ? (double) *next : (double) (positions.front() + mLength);
+    const auto before = next != positions.begin() ? (double) *(next - 1) : (double) (positions.back() - mLength);
+
+    const auto closest = after - position < position - before ? after : before;
+
+    // Sparse onsets can be far away, in parts of a memory-mapped sample that nothing keeps in memory
+    return std::abs(closest - position) <= maxDistance ? closest : position;
+}
+
+template <class Sample>
+bool SampleIndex::analyse(const SampleStorage& storage, double sampleRate, const std::function<bool()>& shouldStop)
+{
+    mLength = storage.getLength(0);
+
+    const auto numChannels = storage.getNumChannels();
+    const auto scale = (std::is_same_v<Sample, std::int16_t> ? GrainKernels::kInt16Scale : 1.f) / (float) numChannels;
+    const auto hop = juce::jmax(1, juce::roundToInt(sampleRate * kHopSeconds));
+
+    // Energy of the first difference of every frame, which stresses the high frequencies transients start with
+    std::vector<float> energies;
+    energies.reserve((size_t) (mLength / hop + 1));
+
+    auto readMono = [&storage, numChannels, scale] (int i)
+    {
+        auto value = 0.f;
+        for (int channel = 0; channel < numChannels; channel++)
+            value += (float) static_cast<const Sample*>(storage.getReadPointer(channel, 0))[i];
+
+        return value * scale;
+    };
+
+    auto previous = 0.f;
+    auto frameEnergy = 0.f;
+
+    for (int blockStart = 0; blockStart < mLength; blockStart += kBlockSize)
+    {
+        if (shouldStop())
+            return false;
+
+        const auto blockEnd = juce::jmin(mLength, blockStart + kBlockSize);
+
+        for (int i = blockStart; i < blockEnd; i++)
+        {
+            const auto value = readMono(i);
+
+            if (previous < 0.f && value >= 0.f && i > 0)
+                mZeroCrossings.push_back(i);
+
+            const auto difference = value - previous;
+            frameEnergy += difference * difference;
+            previous = value;
+
+            if ((i + 1) % hop == 0 || i + 1 == mLength)
+            {
+                energies.push_back(frameEnergy / (float) hop);
+                frameEnergy = 0.f;
+            }
+        }
+    }
+
+    // How far the log energy of each frame rises above the frames just before it
+    const auto numFrames = (int) energies.size();
+    std::vector<float> rises ((size_t) numFrames, 0.f);
+    for (int frame = 1; frame < numFrames; frame++)
+    {
+        const auto firstBefore = juce::jmax(0, frame - 3);
+        auto before = 0.f;
+        for (int k = firstBefore; k < frame; k++)
+            before += energies[(size_t) k];
+        before /= (float) (frame - firstBefore);
+
+        rises[(size_t) frame] = juce::jmax(0.f, std::log(energies[(size_t) frame] + kSilence) - std::log(before + kSilence));
+    }
+
+    // Running sums for the average rise around every frame
+    std::vector<double> sums ((size_t) numFrames + 1, 0.);
+    for (int frame = 0; frame < numFrames; frame++)
+        sums[(size_t) frame + 1] = sums[(size_t) frame] + rises[(size_t) frame];
+
+    const auto thresholdFrames = juce::jmax(1, juce::roundToInt(kThresholdSeconds / kHopSeconds));
+    const auto minSpacing = juce::jmax(1, juce::roundToInt(sampleRate * kMinOnsetSpacingSeconds));
+    auto lastOnset = -minSpacing;
+
+    for (int frame = 1; frame < numFrames; frame++)
+    {
+        if (frame % kBlockSize == 0 && shouldStop())
+            return false;
+
+        const auto rise = rises[(size_t) frame];
+        const auto first = juce::jmax(0, frame - thresholdFrames);
+        const auto last = juce::jmin(numFrames, frame + thresholdFrames + 1);
+        const auto average = (float) ((sums[(size_t) last] - sums[(size_t) first]) / (double) (last - first));
+
+        if (rise < average + kThresholdRise)
+            continue;
+
+        // Only the strongest frame of a rise that spans several
+        auto isPeak = true;
+        for (int k = juce::jmax(0, frame - 2); k <= juce::jmin(numFrames - 1, frame + 2) && isPeak; k++)
+            isPeak = k == frame || rises[(size_t) k] < rise || (k > frame && rises[(size_t) k] == rise);
+
+        const auto frameStart = frame * hop;
+        if (!isPeak || frameStart - lastOnset < minSpacing)
+            continue;
+
+        // The transient starts where the difference first gets close to its largest in the frame
+        const auto frameEnd = juce::jmin(mLength, frameStart + hop);
+        auto largest = 0.f;
+        for (int i = juce::jmax(1, frameStart); i < frameEnd; i++)
+            largest = juce::jmax(largest, std::abs(readMono(i) - readMono(i - 1)));
+
+        auto onset = frameStart;
+        while (onset + 1 < frameEnd && std::abs(readMono(onset + 1) - readMono(onset)) < 0.5f * largest)
+            onset++;
+
+        // Back to the zero crossing in front of it, if there is one within a frame
+        const auto crossing = std::upper_bound(mZeroCrossings.begin(), mZeroCrossings.end(), onset);
+        if (crossing != mZeroCrossings.begin() && *(crossing - 1) >= onset - hop)
+            onset = *(crossing - 1);
+
+        mOnsets.push_back(onset);
+        lastOnset = frameStart;
+    }
+
+    return true;
+}
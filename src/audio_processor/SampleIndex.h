@@ -0,0 +1,63 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <vector>
+#include <juce_core/juce_core.h>
+
+#include "SampleStorage.h"
+
+/**
+ * Sorted positions of the onsets and upward zero crossings of a sample, found once when the sample loads.
+ * Grains snap their start to the closest one with a binary search, so snapping costs the audio thread O(log n).
+ *
+ * Onsets are the frames where the energy of the first difference of the mono mix jumps well above its
+ * surroundings, moved back to the zero crossing in front of them so grains start there without a click.
+ */
+class SampleIndex
+{
+public:
+    // Keep in sync with the "Position Snap" parameter choices
+    enum class Snap
+    {
+        off,
+        zeroCrossings,
+        onsets
+    };
+
+    static constexpr int kNumSnaps = 3;
+
+    /**
+     * Analyses level 0 of storage, which must have its levels built. Returns nullptr as soon as shouldStop does,
+     * which is asked between blocks of samples. Takes a while for long samples, not for the audio thread.
+     */
+    static std::shared_ptr<const SampleIndex> create(const SampleStorage& storage, double sampleRate,
+                                                     const std::function<bool()>& shouldStop);
+
+    /**
+     * The indexed position closest to position, both in samples of level 0, looking across the ends of the sample.
+     * Like the result, position may be up to one length outside the sample. Returns it unchanged if snap is off
+     * or there is nothing to snap to within maxDistance samples.
+     */
+    double snap(double position, Snap snap, double maxDistance) const noexcept;
+
+    // Farthest grains snap, SamplePrefetcher keeps this much more around the spawn positions in memory
+    static constexpr double kMaxSnapSeconds = 0.5;
+
+    int getNumOnsets() const noexcept { return (int) mOnsets.size(); }
+    int getNumZeroCrossings() const noexcept { return (int) mZeroCrossings.size(); }
+
+private:
+    SampleIndex() = default;
+
+    template <class Sample>
+    bool analyse(const SampleStorage& storage, double sampleRate, const std::function<bool()>& shouldStop);
+
+    //==========================================================================================
+
+    int mLength = 0;
+    std::vector<int> mZeroCrossings;
+    std::vector<int> mOnsets;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SampleIndex)
+};
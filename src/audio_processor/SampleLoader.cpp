@@ -0,0 +1,359 @@
+#include "./SampleLoader.h"
+
+namespace
+{
+    void convertToInt16(const float* source, std::int16_t* destination, int numSamples)
+    {
+        for (int i = 0; i < numSamples; i++)
+            destination[i] = (std::int16_t) juce::jlimit(-32768, 32767, juce::roundToInt(source[i] * 32768.f));
+    }
+
+    // Semitones of the letter of a note name above C, -1 if it is none
+    int getPitchClass(juce::juce_wchar letter)
+    {
+        switch (juce::CharacterFunctions::toUpperCase(letter))
+        {
+            case 'C': return 0;
+            case 'D': return 2;
+            case 'E': return 4;
+            case 'F': return 5;
+            case 'G': return 7;
+            case 'A': return 9;
+            case 'B': return 11;
+            default:  return -1;
+        }
+    }
+}
+
+SampleLoader::SampleLoader(SynthAudioSource& synthAudioSource, juce::AudioProcessorValueTreeState& apvts)
+    : juce::Thread("Sample Loader"),
+      mSynthAudioSource(synthAudioSource),
+      mCompactSamplesParam(apvts.getRawParameterValue("Compact Samples")),
+      mResampleParam(apvts.getRawParameterValue("Resample To Host Rate"))
+{
+    mFormatManager.registerBasicFormats();
+    startThread(juce::Thread::Priority::background);
+}
+
+SampleLoader::~SampleLoader()
+{
+    cancel();
+    stopThread(5000);
+}
+
+void SampleLoader::loadFile(const juce::File& file)
+{
+    loadFiles(juce::Array<juce::File>(file));
+}
+
+void SampleLoader::loadFiles(const juce::Array<juce::File>& files)
+{
+    jassert(!files.isEmpty());
+
+    {
+        const juce::ScopedLock sl (mLock);
+        mFiles = files;
+        mHasPendingFiles = true;
+        mGeneration++;
+    }
+
+    mProgress = 0.f;
+    mState = State::loading;
+    sendChangeMessage();
+    notify();
+}
+
+void SampleLoader::cancel()
+{
+    {
+        const juce::ScopedLock sl (mLock);
+        mHasPendingFiles = false;
+        mGeneration++;
+    }
+
+    mState = State::idle;
+    sendChangeMessage();
+}
+
+void SampleLoader::setHostSampleRate(double sampleRate)
+{
+    if (mHostSampleRate.exchange(sampleRate) == sampleRate || *mResampleParam < 0.5f)
+        return;
+
+    // Voices keep playing the samples at the old rate until the new ones are ready
+    const auto files = getFiles();
+    if (!files.isEmpty())
+        loadFiles(files);
+}
+
+juce::File SampleLoader::getFile() const
+{
+    const juce::ScopedLock sl (mLock);
+    return mFiles.isEmpty() ? juce::File() : mFiles.getFirst();
+}
+
+juce::Array<juce::File> SampleLoader::getFiles() const
+{
+    const juce::ScopedLock sl (mLock);
+    return mFiles;
+}
+
+int SampleLoader::getRootNoteFromFileName(const juce::File& file, int defaultNote)
+{
+    const auto name = file.getFileNameWithoutExtension().trimEnd();
+    auto end = name.length();
+
+    // The octave, which may be negative
+    auto start = end;
+    while (start > 0 && juce::CharacterFunctions::isDigit(name[start - 1]) && end - start < 2)
+        start--;
+    if (start == end)
+        return defaultNote;
+
+    auto octave = name.substring(start, end).getIntValue();
+    if (start > 0 && name[start - 1] == '-')
+    {
+        octave = -octave;
+        start--;
+    }
+
+    // An accidental, a b is only one if there is a note letter in front of it
+    auto accidental = 0;
+    if (start > 1 && name[start - 1] == '#')
+        accidental = 1;
+    else if (start > 1 && name[start - 1] == 'b' && getPitchClass(name[start - 2]) >= 0)
+        accidental = -1;
+    start -= std::abs(accidental);
+
+    // The letter must not be the end of a longer word
+    if (start < 1 || getPitchClass(name[start - 1]) < 0 || (start > 1 && juce::CharacterFunctions::isLetter(name[start - 2])))
+        return defaultNote;
+
+    const auto note = (octave + 1) * 12 + getPitchClass(name[start - 1]) + accidental;
+    return juce::isPositiveAndBelow(note, 128) ? note : defaultNote;
+}
+
+void SampleLoader::run()
+{
+    while (!threadShouldExit())
+    {
+        juce::Array<juce::File> files;
+        auto generation = 0;
+        {
+            const juce::ScopedLock sl (mLock);
+            if (mHasPendingFiles)
+            {
+                files = mFiles;
+                generation = mGeneration.load();
+                mHasPendingFiles = false;
+            }
+        }
+
+        if (files.isEmpty())
+        {
+            wait(-1);
+            continue;
+        }
+
+        if (!load(files, generation) && !isCancelled(generation))
+        {
+            mState = State::failed;
+            sendChangeMessage();
+        }
+    }
+}
+
+bool SampleLoader::load(const juce::Array<juce::File>& files, int generation)
+{
+    const auto format = *mCompactSamplesParam >= 0.5f ? GrainKernels::SampleFormat::int16 : GrainKernels::SampleFormat::float32;
+    const auto targetSampleRate = *mResampleParam >= 0.5f ? mHostSampleRate.load() : 0.;
+
+    // A single file plays all notes, "Root Note" sets which one plays it at its original pitch
+    juce::Array<int> rootNotes;
+    for (const auto& file : files)
+        rootNotes.add(files.size() == 1 ? MultigrainSound::kDefaultRootNote
+                                        : getRootNoteFromFileName(file, MultigrainSound::kDefaultRootNote));
+
+    const auto noteMasks = Keymap::splitKeyboard(rootNotes);
+    auto keymap = std::make_unique<Keymap>();
+
+    for (int i = 0; i < files.size(); i++)
+    {
+        const auto progressRange = juce::Range<float>((float) i / (float) files.size(), (float) (i + 1) / (float) files.size());
+        auto sample = getSample(files[i], format, targetSampleRate, generation, progressRange);
+        if (isCancelled(generation) || threadShouldExit())
+            return true;
+
+        if (sample.storage == nullptr)
+            return false;
+
+        keymap->addZone(new MultigrainSound(files[i].getFileNameWithoutExtension(), std::move(sample.storage),
+                                            std::move(sample.index), sample.sampleRate, noteMasks[i], rootNotes[i]));
+    }
+
+    if (isCancelled(generation))
+        return true;
+
+    mSynthAudioSource.setKeymap(std::move(keymap));
+
+    mProgress = 1.f;
+    mState = State::finished;
+    sendChangeMessage();
+    return true;
+}
+
+SampleCache::Sample SampleLoader::getSample(const juce::File& file, GrainKernels::SampleFormat format, double targetSampleRate,
+                                            int generation, juce::Range<float> progressRange)
+{
+    // Another instance may have decoded the same contents already
+    const auto contentHash = mCache->getContentHash(file);
+    auto sample = contentHash.isNotEmpty() ? mCache->find(contentHash, format, targetSampleRate) : SampleCache::Sample();
+    if (sample.storage != nullptr)
+        return sample;
+
+    if (targetSampleRate > 0.)
+    {
+        // Only the resampled sample is played, so the source is decoded without levels or index and not cached.
+        // Another instance that plays the file at its own rate can still spare us decoding it.
+        // Decoding and resampling take about as long as each other
+        const auto middle = progressRange.getStart() + 0.5f * progressRange.getLength();
+        auto source = contentHash.isNotEmpty() ? mCache->find(contentHash, GrainKernels::SampleFormat::float32, 0.)
+                                               : SampleCache::Sample();
+        if (source.storage == nullptr)
+            source = decode(file, GrainKernels::SampleFormat::float32, false, generation, progressRange.withEnd(middle));
+
+        if (source.storage == nullptr || isCancelled(generation) || threadShouldExit())
+            return {};
+
+        sample = resample(source, format, targetSampleRate, generation, progressRange.withStart(middle));
+    }
+    else
+    {
+        sample = decode(file, format, true, generation, progressRange);
+    }
+
+    if (sample.storage == nullptr)
+        return {};
+
+    // Analysed before the sample is shared, so every instance gets the index with it
+    sample.index = SampleIndex::create(*sample.storage, sample.sampleRate, [this, generation]
+    {
+        return isCancelled(generation) || threadShouldExit();
+    });
+
+    if (sample.index == nullptr || contentHash.isEmpty())
+        return sample;
+
+    return mCache->add(contentHash, format, targetSampleRate, std::move(sample));
+}
+
+SampleCache::Sample SampleLoader::decode(const juce::File& file, GrainKernels::SampleFormat format, bool withLevels,
+                                         int generation, juce::Range<float> progressRange)
+{
+    auto reader = createReader(file);
+    if (reader == nullptr || reader->sampleRate <= 0 || reader->lengthInSamples <= 0
+        || reader->lengthInSamples > kMaxSampleLength)
+        return {};
+
+    // The whole sample is decoded into the storage the sound keeps, long samples end up in a mapped file
+    const auto length = (int) reader->lengthInSamples;
+    const auto numChannels = juce::jmin(2, (int) reader->numChannels);
+    const auto levelLengths = withLevels ? MultigrainSound::getLevelLengths(length) : juce::Array<int>(length);
+    auto storage = std::make_shared<SampleStorage>(numChannels, levelLengths, format);
+    if (!storage->isValid())
+        return {};
+
+    if (format == GrainKernels::SampleFormat::int16)
+        mChunk.setSize(numChannels, kChunkSize, false, false, true);
+
+    for (int position = 0; position < length; position += kChunkSize)
+    {
+        if (isCancelled(generation) || threadShouldExit())
+            return {};
+
+        const auto numSamples = juce::jmin(kChunkSize, length - position);
+
+        // Floats are decoded straight into the storage, 16 bit samples are converted from a chunk of floats
+        float* channels[2] = {};
+        for (int channel = 0; channel < numChannels; channel++)
+            channels[channel] = format == GrainKernels::SampleFormat::int16 ? mChunk.getWritePointer(channel)
+                                                                             : storage->getWritePointer<float>(channel, 0) + position;
+
+        if (!reader->read(channels, numChannels, position, numSamples))
+            return {};
+
+        if (format == GrainKernels::SampleFormat::int16)
+            for (int channel = 0; channel < numChannels; channel++)
+                convertToInt16(channels[channel], storage->getWritePointer<std::int16_t>(channel, 0) + position, numSamples);
+
+        mProgress = progressRange.getStart() + progressRange.getLength() * (float) (position + numSamples) / (float) length;
+        sendChangeMessage();
+    }
+
+    if (withLevels)
+        storage->buildLevels();
+
+    return { std::move(storage), nullptr, reader->sampleRate };
+}
+
+SampleCache::Sample SampleLoader::resample(const SampleCache::Sample& source, GrainKernels::SampleFormat format,
+                                           double targetSampleRate, int generation, juce::Range<float> progressRange)
+{
+    const PolyphaseResampler resampler (source.sampleRate, targetSampleRate);
+    const auto& input = *source.storage;
+    const auto inputLength = input.getLength(0);
+
+    const auto outputLength = resampler.getOutputLength(inputLength);
+    if (outputLength > kMaxSampleLength)
+        return {};
+
+    const auto length = (int) outputLength;
+    const auto numChannels = input.getNumChannels();
+    auto storage = std::make_shared<SampleStorage>(numChannels, MultigrainSound::getLevelLengths(length), format);
+    if (!storage->isValid())
+        return {};
+
+    if (format == GrainKernels::SampleFormat::int16)
+        mChunk.setSize(numChannels, kChunkSize, false, false, true);
+
+    for (int position = 0; position < length; position += kChunkSize)
+    {
+        if (isCancelled(generation) || threadShouldExit())
+            return {};
+
+        const auto numSamples = juce::jmin(kChunkSize, length - position);
+
+        for (int channel = 0; channel < numChannels; channel++)
+        {
+            const auto* channelInput = static_cast<const float*>(input.getReadPointer(channel, 0));
+
+            if (format == GrainKernels::SampleFormat::int16)
+            {
+                resampler.process(channelInput, inputLength, mChunk.getWritePointer(channel), position, numSamples);
+                convertToInt16(mChunk.getReadPointer(channel), storage->getWritePointer<std::int16_t>(channel, 0) + position, numSamples);
+            }
+            else
+            {
+                resampler.process(channelInput, inputLength, storage->getWritePointer<float>(channel, 0) + position, position, numSamples);
+            }
+        }
+
+        mProgress = progressRange.getStart() + progressRange.getLength() * (float) (position + numSamples) / (float) length;
+        sendChangeMessage();
+    }
+
+    storage->buildLevels();
+    return { std::move(storage), nullptr, resampler.getOutputSampleRate() };
+}
+
+std::unique_ptr<juce::AudioFormatReader> SampleLoader::createReader(const juce::File& file)
+{
+    if (auto* format = mFormatManager.findFormatForFileExtension(file.getFileExtension()))
+    {
+        std::unique_ptr<juce::MemoryMappedAudioFormatReader> mappedReader (format->createMemoryMappedReader(file));
+        if (mappedReader != nullptr && mappedReader->mapEntireFile())
+            return mappedReader;
+    }
+
+    return std::unique_ptr<juce::AudioFormatReader>(mFormatManager.createReaderFor(file));
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <atomic>
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <juce_audio_processors/juce_audio_processors.h>
+#include <juce_events/juce_events.h>
+
+#include "Keymap.h"
+#include "MultigrainSound.h"
+#include "PolyphaseResampler.h"
+#include "SampleCache.h"
+#include "SynthAudioSource.h"
+
+/**
+ * Decodes samples on a background thread and hands the finished keymap to the synth.
+ *
+ * The file is read in chunks into a buffer that is allocated once its length is known, so a load can be cancelled
+ * between any two chunks. Starting a new load cancels the one that is running. Listeners get a change message
+ * whenever the progress or the state changes.
+ *
+ * Decoded samples are shared with the other plugin instances through the SampleCache, a file whose contents
+ * another instance already plays is not decoded again.
+ *
+ * With "Resample To Host Rate" on, samples are converted to the host sample rate once they are decoded, so the
+ * voices only interpolate to transpose. A new host rate reloads the samples that are playing.
+ */
+class SampleLoader : public juce::ChangeBroadcaster,
+                     private juce::Thread
+{
+public:
+    SampleLoader(SynthAudioSource& synthAudioSource, juce::AudioProcessorValueTreeState& apvts);
+    ~SampleLoader() override;
+
+    enum class State
+    {
+        idle,
+        loading,
+        finished,
+        failed
+    };
+
+    // Starts loading file as a single zone that plays all notes, a load that is still running is abandoned
+    void loadFile(const juce::File& file);
+
+    /**
+     * Starts loading a multisample, one zone per file. The root note of a zone is the note name at the end of
+     * its file name, like "Piano C#4.wav" or "piano_Db4.wav", C4 being MIDI note 60. Files without one play
+     * at their original pitch on C4. Every note is played by the zone with the closest root.
+     */
+    void loadFiles(const juce::Array<juce::File>& files);
+
+    // Abandons the running load, the synth keeps playing the sound it has
+    void cancel();
+
+    State getState() const noexcept { return mState.load(); }
+
+    // Fraction of the file that has been decoded, between 0 and 1
+    float getProgress() const noexcept { return mProgress.load(); }
+
+    // The first file of the last load
+    juce::File getFile() const;
+
+    // The files of the last load
+    juce::Array<juce::File> getFiles() const;
+
+    /**
+     * The rate samples are resampled to, called by prepareToPlay. When the rate changes while resampling is on,
+     * the files of the last load are loaded again.
+     */
+    void setHostSampleRate(double sampleRate);
+
+    // Note number of the note name file ends with, like C4 or F#-1. defaultNote if there is none
+    static int getRootNoteFromFileName(const juce::File& file, int defaultNote);
+
+    // Samples longer than this are refused, the grains address samples with 32 bit integers
+    static constexpr juce::int64 kMaxSampleLength = juce::int64(1) << 30;
+
+private:
+    void run() override;
+
+    // Returns false if a file could not be read, cancelled loads return true
+    bool load(const juce::Array<juce::File>& files, int generation);
+
+    /**
+     * The decoded sample of file resampled to targetSampleRate with its SampleIndex, from the cache if another
+     * instance has it already.
+     * A targetSampleRate of 0 keeps the rate of the file.
+     */
+    SampleCache::Sample getSample(const juce::File& file, GrainKernels::SampleFormat format, double targetSampleRate,
+                                  int generation, juce::Range<float> progressRange);
+
+    /**
+     * Reads file into new storage, no storage if that failed or the load was cancelled. With withLevels false
+     * the storage only has level 0 without guard samples, enough to resample. The progress moves through
+     * progressRange.
+     */
+    SampleCache::Sample decode(const juce::File& file, GrainKernels::SampleFormat format, bool withLevels,
+                               int generation, juce::Range<float> progressRange);
+
+    // Resamples level 0 of source, which is stored as floats, into new storage and builds its levels
+    SampleCache::Sample resample(const SampleCache::Sample& source, GrainKernels::SampleFormat format, double targetSampleRate,
+                                 int generation, juce::Range<float> progressRange);
+
+    // WAV and AIFF files are read through a memory-mapped reader, other formats through a stream
+    std::unique_ptr<juce::AudioFormatReader> createReader(const juce::File& file);
+
+    bool isCancelled(int generation) const noexcept { return generation != mGeneration.load(); }
+
+    //==========================================================================================
+
+    // Samples decoded between two checks for cancellation
+    static constexpr int kChunkSize = 1 << 16;
+
+    SynthAudioSource& mSynthAudioSource;
+    juce::AudioFormatManager mFormatManager;
+    juce::SharedResourcePointer<SampleCache> mCache;
+    std::atomic<float>* mCompactSamplesParam;
+    std::atomic<float>* mResampleParam;
+    std::atomic<double> mHostSampleRate { 0. };
+
+    // Decoded or resampled chunk of a sample that is stored as 16 bit integers
+    juce::AudioBuffer<float> mChunk;
+
+    juce::CriticalSection mLock;
+    juce::Array<juce::File> mFiles;
+    bool mHasPendingFiles = false;
+
+    // Incremented by every new load or cancel, a load only continues while it is the latest one
+    std::atomic<int> mGeneration { 0 };
+    std::atomic<State> mState { State::idle };
+    std::atomic<float> mProgress { 0.f };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SampleLoader)
+};
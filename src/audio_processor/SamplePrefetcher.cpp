@@ -0,0 +1,65 @@
+#include "./SamplePrefetcher.h"
+
+SamplePrefetcher::SamplePrefetcher(juce::AudioProcessorValueTreeState& apvts, const juce::Array<MultigrainVoice*>& voices)
+    : juce::Thread("Sample Prefetcher"),
+      mPositionParam(apvts.getRawParameterValue("Position")),
+      mPositionRandomParam(apvts.getRawParameterValue("Position Random")),
+      mVoices(voices)
+{
+    startThread(juce::Thread::Priority::high);
+}
+
+SamplePrefetcher::~SamplePrefetcher()
+{
+    stopThread(1000);
+}
+
+void SamplePrefetcher::setZones(const juce::ReferenceCountedArray<MultigrainSound>& zones)
+{
+    const juce::ScopedLock sl (mLock);
+    mZones = zones;
+    notify();
+}
+
+void SamplePrefetcher::run()
+{
+    while (!threadShouldExit())
+    {
+        juce::ReferenceCountedArray<MultigrainSound> zones;
+        {
+            const juce::ScopedLock sl (mLock);
+            zones = mZones;
+        }
+
+        for (auto* sound : zones)
+        {
+            if (sound->isMemoryMapped())
+            {
+                prefetch(*sound);
+                sound->releaseStalePrefetches();
+            }
+        }
+
+        // Never the last references, SynthAudioSource frees its sounds itself
+        zones.clear();
+        wait(kIntervalMilliseconds);
+    }
+}
+
+void SamplePrefetcher::prefetch(const MultigrainSound& sound) const
+{
+    const auto length = (double) sound.getLength(0);
+    const auto radius = 0.5 * (double) mPositionRandomParam->load() * length
+                        + (kMarginSeconds + SampleIndex::kMaxSnapSeconds) * sound.getSourceSampleRate();
+
+    // Where new notes start
+    sound.prefetch((double) mPositionParam->load() * length, radius);
+
+    // A voice may just have moved on to another sound, which only costs touching a few pages for nothing
+    for (auto* voice : mVoices)
+    {
+        const auto position = voice->getSpawnPosition();
+        if (position >= 0. && voice->getSpawnSound() == &sound)
+            sound.prefetch(position, radius);
+    }
+}
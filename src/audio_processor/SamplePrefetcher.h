@@ -0,0 +1,48 @@
+#pragma once
+
+#include <juce_audio_processors/juce_audio_processors.h>
+
+#include "MultigrainSound.h"
+#include "MultigrainVoice.h"
+
+/**
+ * Keeps the parts of memory-mapped sounds that are about to be played in memory, so the audio thread does not
+ * have to wait for the disk. A background thread regularly locks the samples around the spawn position of
+ * every playing voice and around the "Position" parameter in every zone, widened by the "Position Random" range
+ * and by how far grains may snap to an onset or zero crossing,
+ * and unlocks what has not been asked for in a while. Where the OS limits locked memory, the rest is only read
+ * in, which is best-effort, the OS may page it out again before it is played.
+ *
+ * Sounds that live on the heap are left alone.
+ */
+class SamplePrefetcher : private juce::Thread
+{
+public:
+    // The voices have to outlive the prefetcher
+    SamplePrefetcher(juce::AudioProcessorValueTreeState& apvts, const juce::Array<MultigrainVoice*>& voices);
+    ~SamplePrefetcher() override;
+
+    // The zones new notes play, an empty array stops prefetching. Must not be called from the audio thread
+    void setZones(const juce::ReferenceCountedArray<MultigrainSound>& zones);
+
+private:
+    void run() override;
+    void prefetch(const MultigrainSound& sound) const;
+
+    //==========================================================================================
+
+    static constexpr int kIntervalMilliseconds = 50;
+
+    // Covers the grains themselves and how far the spawn position moves until the next pass
+    static constexpr double kMarginSeconds = 1.;
+
+    std::atomic<float>* mPositionParam;
+    std::atomic<float>* mPositionRandomParam;
+
+    juce::Array<MultigrainVoice*> mVoices;
+
+    juce::CriticalSection mLock;
+    juce::ReferenceCountedArray<MultigrainSound> mZones;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SamplePrefetcher)
+};
@@ -0,0 +1,292 @@
+#include "./SampleStorage.h"
+
+#if JUCE_WINDOWS
+ #include <windows.h>
+#else
+ #include <sys/mman.h>
+ #include <unistd.h>
+#endif
+
+namespace
+{
+    size_t getSystemPageSize()
+    {
+       #if JUCE_WINDOWS
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        return (size_t) info.dwPageSize;
+       #else
+        return (size_t) sysconf(_SC_PAGESIZE);
+       #endif
+    }
+
+    bool lockMemory(const void* address, size_t numBytes)
+    {
+       #if JUCE_WINDOWS
+        return VirtualLock(const_cast<void*>(address), numBytes) != 0;
+       #else
+        return mlock(address, numBytes) == 0;
+       #endif
+    }
+
+    void unlockMemory(const void* address, size_t numBytes)
+    {
+       #if JUCE_WINDOWS
+        VirtualUnlock(const_cast<void*>(address), numBytes);
+       #else
+        munlock(address, numBytes);
+       #endif
+    }
+
+    // Blackman windowed sinc lowpass that leaves little to fold back when every second sample is dropped
+    constexpr int kDecimationTaps = 63;
+
+    std::array<double, kDecimationTaps> makeDecimationFilter()
+    {
+        const auto pi = juce::MathConstants<double>::pi;
+        const auto cutoff = 0.21; // relative to the sample rate of the level that is decimated
+        const auto centre = kDecimationTaps / 2;
+
+        std::array<double, kDecimationTaps> filter;
+        auto sum = 0.;
+
+        for (int i = 0; i < kDecimationTaps; i++)
+        {
+            const auto x = (double) (i - centre);
+            const auto sinc = i == centre ? 2. * cutoff : std::sin(2. * pi * cutoff * x) / (pi * x);
+            const auto window = 0.42 + 0.5 * std::cos(pi * x / centre) + 0.08 * std::cos(2. * pi * x / centre);
+            filter[(size_t) i] = sinc * window;
+            sum += filter[(size_t) i];
+        }
+
+        for (auto& coefficient : filter)
+            coefficient /= sum;
+
+        return filter;
+    }
+
+    // 16 bit samples stay whole numbers, the kernels scale them back
+    template <class Sample>
+    Sample toSample(double value)
+    {
+        if constexpr (std::is_same_v<Sample, std::int16_t>)
+            return (std::int16_t) juce::jlimit(-32768, 32767, juce::roundToInt(value));
+        else
+            return (Sample) value;
+    }
+}
+
+SampleStorage::SampleStorage(int numChannels, const juce::Array<int>& levelLengths, GrainKernels::SampleFormat format)
+    : mNumChannels(numChannels),
+      mFormat(format),
+      mBytesPerSample(format == GrainKernels::SampleFormat::int16 ? sizeof(std::int16_t) : sizeof(float)),
+      mLevelLengths(levelLengths)
+{
+    size_t numSamples = 0;
+    for (auto length : mLevelLengths)
+    {
+        mLevelOffsets.add(numSamples);
+        numSamples += (size_t) mNumChannels * (size_t) (length + 2 * kGuardSamples);
+    }
+
+    // Wide loads of 16 bit samples read a little past the last guard sample
+    numSamples += kGuardSamples;
+
+    const auto numBytes = numSamples * mBytesPerSample;
+    if (numBytes <= kMaxResidentBytes)
+    {
+        mMemory.calloc(numBytes);
+        mData = mMemory.get();
+        return;
+    }
+
+    // The file is written out as zeros once, after that it is only touched through the mapping
+    mFile = std::make_unique<juce::TemporaryFile>(".multigrain");
+    {
+        juce::FileOutputStream stream (mFile->getFile());
+        if (!stream.openedOk() || !stream.writeRepeatedByte(0, numBytes))
+            return;
+    }
+
+    mMappedFile = std::make_unique<juce::MemoryMappedFile>(mFile->getFile(), juce::MemoryMappedFile::readWrite);
+    if (mMappedFile->getData() == nullptr || mMappedFile->getSize() < numBytes)
+    {
+        mMappedFile.reset();
+        return;
+    }
+
+    mData = static_cast<char*>(mMappedFile->getData());
+
+    // Mappings start on a page boundary, unmapping unlocks whatever is still locked
+    mPageSize = juce::jmax((size_t) 1, getSystemPageSize());
+    const auto numPages = (numBytes + mPageSize - 1) / mPageSize;
+    mLockedPages.assign(numPages, false);
+    mPageRequestTimes.assign(numPages, 0);
+}
+
+SampleStorage::~SampleStorage() = default;
+
+void SampleStorage::keepResident(int level, int startSample, int numSamples) const
+{
+    if (!isMemoryMapped())
+        return;
+
+    const juce::ScopedLock sl (mPageLock);
+
+    const auto length = getLength(level);
+    if (numSamples >= length)
+    {
+        keepRangeResident(level, 0, length);
+        return;
+    }
+
+    startSample %= length;
+    if (startSample < 0)
+        startSample += length;
+
+    const auto samplesToEnd = juce::jmin(numSamples, length - startSample);
+    keepRangeResident(level, startSample, samplesToEnd);
+    keepRangeResident(level, 0, numSamples - samplesToEnd);
+}
+
+void SampleStorage::releaseStalePages() const
+{
+    if (!isMemoryMapped())
+        return;
+
+    const juce::ScopedLock sl (mPageLock);
+    const auto now = juce::Time::getMillisecondCounter();
+
+    // Unlocks runs of stale pages with one call each
+    for (size_t page = 0; page < mLockedPages.size();)
+    {
+        auto isStale = [this, now] (size_t p) { return mLockedPages[p] && now - mPageRequestTimes[p] > kResidentMilliseconds; };
+        if (!isStale(page))
+        {
+            page++;
+            continue;
+        }
+
+        auto endPage = page + 1;
+        while (endPage < mLockedPages.size() && isStale(endPage))
+            endPage++;
+
+        unlockMemory(mData + page * mPageSize, (endPage - page) * mPageSize);
+        std::fill(mLockedPages.begin() + (std::ptrdiff_t) page, mLockedPages.begin() + (std::ptrdiff_t) endPage, false);
+        page = endPage;
+    }
+}
+
+void SampleStorage::keepRangeResident(int level, int startSample, int numSamples) const
+{
+    if (numSamples <= 0)
+        return;
+
+    const auto now = juce::Time::getMillisecondCounter();
+
+    for (int channel = 0; channel < mNumChannels; channel++)
+    {
+        const auto firstByte = (getOffset(channel, level) + (size_t) startSample) * mBytesPerSample;
+        const auto endByte = (getOffset(channel, level) + (size_t) (startSample + numSamples)) * mBytesPerSample;
+        const auto firstPage = firstByte / mPageSize;
+        const auto endPage = juce::jmin(mLockedPages.size(), (endByte + mPageSize - 1) / mPageSize);
+
+        for (auto page = firstPage; page < endPage; page++)
+            mPageRequestTimes[page] = now;
+
+        lockPages(firstPage, endPage);
+    }
+}
+
+void SampleStorage::lockPages(size_t firstPage, size_t endPage) const
+{
+    // Volatile so the reads are not optimised away
+    volatile char sink = 0;
+
+    for (auto page = firstPage; page < endPage;)
+    {
+        if (mLockedPages[page])
+        {
+            page++;
+            continue;
+        }
+
+        auto runEnd = page + 1;
+        while (runEnd < endPage && !mLockedPages[runEnd])
+            runEnd++;
+
+        // Locking reads the pages in. Otherwise read them now, they stay in memory only as long as the OS likes
+        if (lockMemory(mData + page * mPageSize, (runEnd - page) * mPageSize))
+        {
+            std::fill(mLockedPages.begin() + (std::ptrdiff_t) page, mLockedPages.begin() + (std::ptrdiff_t) runEnd, true);
+        }
+        else
+        {
+            for (auto p = page; p < runEnd; p++)
+                sink = mData[p * mPageSize];
+        }
+
+        page = runEnd;
+    }
+
+    juce::ignoreUnused(sink);
+}
+
+void SampleStorage::buildLevels()
+{
+    const auto isInt16 = mFormat == GrainKernels::SampleFormat::int16;
+    isInt16 ? fillGuardSamples<std::int16_t>(0) : fillGuardSamples<float>(0);
+
+    for (int level = 1; level < getNumLevels(); level++)
+        isInt16 ? fillDecimatedLevel<std::int16_t>(level) : fillDecimatedLevel<float>(level);
+}
+
+template <class Sample>
+void SampleStorage::fillDecimatedLevel(int level)
+{
+    const auto sourceLength = getLength(level - 1);
+    const auto decimatedLength = getLength(level);
+    const auto filter = makeDecimationFilter();
+
+    for (int channel = 0; channel < getNumChannels(); channel++)
+    {
+        const auto* in = getWritePointer<Sample>(channel, level - 1);
+        auto* out = getWritePointer<Sample>(channel, level);
+
+        for (int i = 0; i < decimatedLength; i++)
+        {
+            auto sum = 0.;
+
+            // The sample loops, so the filter wraps around its ends too
+            for (int tap = 0; tap < kDecimationTaps; tap++)
+            {
+                auto index = (2 * i + tap - kDecimationTaps / 2) % sourceLength;
+                if (index < 0)
+                    index += sourceLength;
+
+                sum += filter[(size_t) tap] * in[index];
+            }
+
+            out[i] = toSample<Sample>(sum);
+        }
+    }
+
+    fillGuardSamples<Sample>(level);
+}
+
+template <class Sample>
+void SampleStorage::fillGuardSamples(int level)
+{
+    const auto numSamples = getLength(level);
+
+    for (int channel = 0; channel < getNumChannels(); channel++)
+    {
+        auto* samples = getWritePointer<Sample>(channel, level);
+
+        for (int i = 0; i < kGuardSamples; i++)
+        {
+            samples[numSamples + i] = samples[i % numSamples];
+            samples[-1 - i] = samples[numSamples - 1 - (i % numSamples)];
+        }
+    }
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <vector>
+#include <juce_core/juce_core.h>
+
+#include "GrainKernels.h"
+
+/**
+ * Memory for the octave levels of a sound. Every channel of every level is a contiguous run of floats or 16 bit
+ * integers with kGuardSamples free samples in front and behind.
+ *
+ * Samples up to kMaxResidentBytes live on the heap. Longer ones live in a memory-mapped temporary file, so the
+ * OS can page out the parts that are not played. SamplePrefetcher locks the parts around the play positions
+ * in memory, so the audio thread does not have to wait for the disk.
+ */
+class SampleStorage
+{
+public:
+    // Check isValid afterwards, creating the temporary file may fail
+    SampleStorage(int numChannels, const juce::Array<int>& levelLengths, GrainKernels::SampleFormat format);
+    ~SampleStorage();
+
+    bool isValid() const noexcept { return mData != nullptr; }
+    bool isMemoryMapped() const noexcept { return mMappedFile != nullptr; }
+    GrainKernels::SampleFormat getFormat() const noexcept { return mFormat; }
+
+    int getNumChannels() const noexcept { return mNumChannels; }
+    int getNumLevels() const noexcept { return mLevelLengths.size(); }
+    int getLength(int level) const noexcept { return mLevelLengths.getUnchecked(level); }
+
+    /**
+     * Pointers to the first sample of a channel of a level, the guard samples are in front and behind.
+     * Sample is float or std::int16_t, whichever the format is.
+     */
+    template <class Sample>
+    Sample* getWritePointer(int channel, int level) noexcept
+    {
+        jassert(sizeof(Sample) == mBytesPerSample);
+        return reinterpret_cast<Sample*>(mData + getOffset(channel, level) * mBytesPerSample);
+    }
+
+    const void* getReadPointer(int channel, int level) const noexcept { return mData + getOffset(channel, level) * mBytesPerSample; }
+
+    /**
+     * Fills the guard samples of level 0 and lowpasses and decimates every level into the next one.
+     * Call once the sample has been written to level 0, takes a while for long samples.
+     */
+    void buildLevels();
+
+    /**
+     * Locks the pages of numSamples samples of all channels of a level in memory, starting at startSample and
+     * wrapping around the end, until releaseStalePages finds they have not been asked for in a while.
+     *
+     * This is best-effort: where the OS refuses to lock more memory, for example over RLIMIT_MEMLOCK or the
+     * working set of the process on Windows, the pages are only read so they are in memory for now, and the
+     * OS may still page them out before they are played. Does nothing for samples on the heap.
+     */
+    void keepResident(int level, int startSample, int numSamples) const;
+
+    // Unlocks the pages that keepResident has not been asked for within kResidentMilliseconds
+    void releaseStalePages() const;
+
+    // How long locked pages stay locked without being asked for again
+    static constexpr juce::uint32 kResidentMilliseconds = 500;
+
+    static constexpr int kGuardSamples = 4;
+
+    // Larger samples are memory-mapped
+    static constexpr size_t kMaxResidentBytes = size_t(64) << 20;
+
+private:
+    size_t getOffset(int channel, int level) const noexcept
+    {
+        return mLevelOffsets.getUnchecked(level) + (size_t) channel * (size_t) (getLength(level) + 2 * kGuardSamples) + kGuardSamples;
+    }
+
+    void keepRangeResident(int level, int startSample, int numSamples) const;
+    void lockPages(size_t firstPage, size_t endPage) const;
+
+    // Lowpasses and decimates the level before into level
+    template <class Sample>
+    void fillDecimatedLevel(int level);
+
+    // Copies the start of every channel of a level behind its end and the end in front of its start
+    template <class Sample>
+    void fillGuardSamples(int level);
+
+    //==========================================================================================
+
+    int mNumChannels;
+    GrainKernels::SampleFormat mFormat;
+    size_t mBytesPerSample;
+    juce::Array<int> mLevelLengths;
+    juce::Array<size_t> mLevelOffsets;
+
+    juce::HeapBlock<char> mMemory;
+
+    // The mapping has to go before the file it maps is deleted
+    std::unique_ptr<juce::TemporaryFile> mFile;
+    std::unique_ptr<juce::MemoryMappedFile> mMappedFile;
+
+    char* mData = nullptr;
+
+    // Which pages of the mapping are locked and when they were last asked for, used by the prefetch threads only
+    size_t mPageSize = 0;
+    mutable std::vector<bool> mLockedPages;
+    mutable std::vector<juce::uint32> mPageRequestTimes;
+    juce::CriticalSection mPageLock;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SampleStorage)
+};
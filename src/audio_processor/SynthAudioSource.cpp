@@ -7,48 +7,196 @@ SynthAudioSource::SynthAudioSource(
 )
 : 
     mKeyboardState(inKeyboardState),
-    mApvts(inApvts)
+    mApvts(inApvts),
+    mGrainBudgetParam(inApvts.getRawParameterValue("Grain Budget")),
+    mParallelVoicesParam(inApvts.getRawParameterValue("Parallel Voices")),
+    mPolyphonyParam(inApvts.getRawParameterValue("Polyphony")),
+    mOversamplingParam(inApvts.getRawParameterValue("Oversampling"))
 {
+    // The audio thread renders voices as well, more workers than voices would have nothing to do.
+    // The workers are only started once "Parallel Voices" is turned on
+    const auto numWorkers = juce::jmin(kMaxNumVoices - 1, juce::SystemStats::getNumCpus() - 1);
+    if (numWorkers > 0)
+        mRenderThreadPool = std::make_unique<RenderThreadPool>(numWorkers);
+
+    juce::Array<MultigrainVoice*> voices;
+    for (int i = 0; i < kMaxNumVoices; i++)
+        voices.add(static_cast<MultigrainVoice*>(mSynth.addVoice(new MultigrainVoice(mApvts, mGrainPool))));
+    mSynth.prepareVoiceLists();
+
+    mPrefetcher = std::make_unique<SamplePrefetcher>(mApvts, voices);
+
+    startTimer(500);
 }
 
-SynthAudioSource::~SynthAudioSource() = default;
+SynthAudioSource::~SynthAudioSource()
+{
+    stopTimer();
+    mPrefetcher.reset();
+
+    // The voices give their grains back to the pool, which is destroyed before mSynth
+    mSynth.clearVoiceLists();
+    mSynth.clearVoices();
+
+    delete mPendingKeymap.exchange(nullptr);
+    delete mCurrentKeymap;
+    for (auto& slot : mRetiringKeymaps)
+        delete slot.exchange(nullptr);
+}
+
+void SynthAudioSource::prepareToPlay(int samplesPerBlockExpected, double sampleRate)
+{
+    startRenderWorkersIfNeeded();
+
+    mSamplesPerBlock = samplesPerBlockExpected;
+    mSnapshotIntervalSamples = juce::roundToInt(sampleRate * kSnapshotIntervalSeconds);
+
+    // Enough grains for the largest budget, allocated once as no bank holds grains before the first call
+    const auto maxNumGrains = (int) mApvts.getParameter("Grain Budget")->getNormalisableRange().end;
+    if (mGrainPool.getCapacity() != maxNumGrains)
+        mGrainPool.prepare(maxNumGrains);
+
+    mSynth.setOversamplingFactor(getOversamplingFactor());
+    mSynth.prepare(sampleRate, mSamplesPerBlock);
 
-void SynthAudioSource::prepareToPlay(int /*samplesPerBlockExpected*/, double sampleRate)
+    // Voices render at the oversampled rate, in blocks of up to the largest oversampling factor times the block size
+    for (int i = 0; i < mSynth.getNumVoices(); i++)
+        static_cast<MultigrainVoice*>(mSynth.getVoice(i))->prepareToPlay(mSynth.getSampleRate(), getVoiceBlockSize());
+}
+
+void SynthAudioSource::releaseResources()
 {
-    mSynth.setCurrentPlaybackSampleRate(sampleRate);
+    // No more blocks are coming, the workers can park
+    if (mRenderThreadPool != nullptr)
+        mRenderThreadPool->setActive(false);
 }
 
-void SynthAudioSource::releaseResources() {}
+void SynthAudioSource::startRenderWorkersIfNeeded()
+{
+    if (mRenderThreadPool != nullptr && *mParallelVoicesParam >= 0.5f)
+        mRenderThreadPool->start();
+}
 
 void SynthAudioSource::getNextAudioBlock(
     const juce::AudioSourceChannelInfo& bufferToFill
 )
 {
+    pickUpNewKeymap();
+
     auto theMidiBuffer = juce::MidiBuffer();
     mKeyboardState.processNextMidiBuffer(theMidiBuffer, 0, bufferToFill.numSamples, true);
 
+    mGrainPool.setBudget((int) *mGrainBudgetParam);
+    // The synth marks the pool active while it renders several voices at once
+    const auto parallelVoices = *mParallelVoicesParam >= 0.5f && mRenderThreadPool != nullptr && mRenderThreadPool->isRunning();
+    if (mRenderThreadPool != nullptr && !parallelVoices)
+        mRenderThreadPool->setActive(false);
+
+    mSynth.setThreadPool(parallelVoices ? mRenderThreadPool.get() : nullptr);
+    mSynth.setPolyphony((int) *mPolyphonyParam);
+    mSynth.setOversamplingFactor(getOversamplingFactor());
+
     mSynth.renderNextBlock(*bufferToFill.buffer, theMidiBuffer, bufferToFill.startSample, bufferToFill.numSamples);
+    publishGrainSnapshot(bufferToFill.numSamples);
+}
+
+int SynthAudioSource::getOversamplingFactor() const noexcept
+{
+    return 1 << juce::jlimit(0, 2, (int) *mOversamplingParam);
+}
+
+int SynthAudioSource::getVoiceBlockSize() const noexcept
+{
+    return mSamplesPerBlock * MultigrainSynthesiser::kMaxOversamplingFactor;
 }
 
-std::vector<Silo*> SynthAudioSource::getSilos() const
+void SynthAudioSource::publishGrainSnapshot(int numSamples) noexcept
 {
-    auto silos = std::vector<Silo*>();
-    for(int i = 0; i < this->mSynth.getNumVoices(); i++) 
+    mSamplesSinceSnapshot += numSamples;
+    if (mSamplesSinceSnapshot < mSnapshotIntervalSamples)
+        return;
+
+    mSamplesSinceSnapshot = 0;
+    mGrainSnapshot.beginWrite();
+
+    auto numActiveVoices = 0;
+    for (int i = 0; i < mSynth.getNumVoices(); i++)
     {
-        auto voice = static_cast<MultigrainVoice*>(this->mSynth.getVoice(i));
-        silos.push_back(&voice->getSilo());
+        auto* voice = static_cast<MultigrainVoice*>(mSynth.getVoice(i));
+        numActiveVoices += voice->isVoiceActive() ? 1 : 0;
+
+        const auto& grainBank = voice->getGrainBank();
+        const auto numGrains = grainBank.getNumActiveGrains();
+        for (int k = 0; k < numGrains; k++)
+        {
+            mGrainSnapshot.addGrain({ (float) grainBank.getRelativeGrainPosition(k).leftPosition,
+                                      grainBank.getGrainAmplitude(k),
+                                      (float) k / (float) numGrains });
+        }
     }
 
-    return silos;
+    mGrainSnapshot.endWrite(numActiveVoices);
 }
 
-void SynthAudioSource::init(MultigrainSound* sound)
+void SynthAudioSource::setKeymap(std::unique_ptr<Keymap> keymap)
 {
-    // clear all previous sounds and voices
-    mSynth.clearSounds();
-    mSynth.clearVoices();
+    const juce::ScopedLock sl (mSoundLock);
+
+    for (auto* sound : keymap->getZones())
+        mSounds.addIfNotAlreadyThere(sound);
+
+    mPrefetcher->setZones(keymap->getZones());
+
+    // A keymap the audio thread has not picked up yet was never played
+    delete mPendingKeymap.exchange(keymap.release(), std::memory_order_acq_rel);
+
+    freeRetiredSounds();
+}
+
+void SynthAudioSource::pickUpNewKeymap() noexcept
+{
+    if (mPendingKeymap.load(std::memory_order_relaxed) == nullptr)
+        return;
+
+    // The replaced keymap needs a slot to be handed back in, otherwise the swap waits for a later block
+    std::atomic<Keymap*>* retiringSlot = nullptr;
+    if (mCurrentKeymap != nullptr)
+    {
+        for (auto& slot : mRetiringKeymaps)
+            if (slot.load(std::memory_order_relaxed) == nullptr)
+                retiringSlot = &slot;
 
-    mSynth.addSound(sound);
-    for (int i = 0; i < kNumVoices; i++)
-        mSynth.addVoice(new MultigrainVoice(mApvts, *sound));
-}
\ No newline at end of file
+        if (retiringSlot == nullptr)
+            return;
+    }
+
+    auto* newKeymap = mPendingKeymap.exchange(nullptr, std::memory_order_acq_rel);
+    if (newKeymap == nullptr)
+        return;
+
+    if (retiringSlot != nullptr)
+        retiringSlot->store(mCurrentKeymap, std::memory_order_release);
+
+    mCurrentKeymap = newKeymap;
+    mSynth.setKeymap(mCurrentKeymap);
+}
+
+void SynthAudioSource::timerCallback()
+{
+    freeRetiredSounds();
+    startRenderWorkersIfNeeded();
+}
+
+void SynthAudioSource::freeRetiredSounds()
+{
+    const juce::ScopedLock sl (mSoundLock);
+
+    for (auto& slot : mRetiringKeymaps)
+        delete slot.exchange(nullptr, std::memory_order_acq_rel);
+
+    // Sounds are only started from a keymap the audio thread holds, which keeps a reference to them.
+    // Once only mSounds refers to a sound no voice can be playing it, nor start playing it
+    for (int i = mSounds.size(); --i >= 0;)
+        if (mSounds.getUnchecked(i)->getReferenceCount() == 1)
+            mSounds.remove(i);
+}
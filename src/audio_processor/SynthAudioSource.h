@@ -1,12 +1,28 @@
 #pragma once
 
+#include <array>
+#include <atomic>
 #include <juce_audio_processors/juce_audio_processors.h>
 #include <juce_audio_formats/juce_audio_formats.h>
 
 #include "MultigrainSound.h"
+#include "MultigrainSynthesiser.h"
 #include "MultigrainVoice.h"
+#include "GrainPool.h"
+#include "GrainSnapshot.h"
+#include "Keymap.h"
+#include "RenderThreadPool.h"
+#include "SamplePrefetcher.h"
 
-class SynthAudioSource : public juce::AudioSource
+/**
+ * Owns the synth, its voices, the keymap and the sounds. Voices are created once and live as long as the source.
+ *
+ * A new keymap is handed to the audio thread through an atomic pointer and picked up at the start of the next block,
+ * notes that are still playing keep the sound they started with. Keymaps the audio thread is done with are handed
+ * back the same way and freed off the audio thread, their sounds once no voice plays them anymore.
+ */
+class SynthAudioSource : public juce::AudioSource,
+                         private juce::Timer
 {
 public:
     SynthAudioSource (
@@ -19,15 +35,76 @@ public:
     void releaseResources() override;
     void getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill) override;
     
-    std::vector<Silo*> getSilos() const;
-    juce::Synthesiser mSynth;
+    // Delay the oversampling adds, the processor reports it to the host
+    int getLatencySamples() const noexcept { return mSynth.getLatencySamples(); }
 
-    void init(MultigrainSound* sound);
+    // The grains that are playing for the editor, which must not look at the voices or the pool itself
+    const GrainSnapshot& getGrainSnapshot() const noexcept { return mGrainSnapshot; }
+    const GrainPool& getGrainPool() const noexcept { return mGrainPool; }
+    MultigrainSynthesiser mSynth;
+
+    // The zones of keymap play new notes from the next block on. Must not be called from the audio thread
+    void setKeymap(std::unique_ptr<Keymap> keymap);
+
+    // Voices are created up front, the "Polyphony" parameter sets how many of them may play
+    static constexpr int kMaxNumVoices = 128;
 private:
+    // Frees the keymaps that were retired by the audio thread and the sounds nothing refers to anymore
+    void timerCallback() override;
+    void freeRetiredSounds();
+
+    // Starts the workers of mRenderThreadPool once "Parallel Voices" is on, message thread only
+    void startRenderWorkersIfNeeded();
+
+    // Switches the synth to a newly published keymap, audio thread only
+    void pickUpNewKeymap() noexcept;
+
+    // 1, 2 or 4 from the "Oversampling" parameter
+    int getOversamplingFactor() const noexcept;
+
+    // Longest block a voice renders in one go, which grows with the oversampling factor
+    int getVoiceBlockSize() const noexcept;
+
+    // Copies the grains into mGrainSnapshot every kSnapshotIntervalSeconds, audio thread only
+    void publishGrainSnapshot(int numSamples) noexcept;
+
     juce::MidiKeyboardState& mKeyboardState;
     juce::AudioProcessorValueTreeState& mApvts;
+    std::atomic<float>* mGrainBudgetParam;
+    std::atomic<float>* mParallelVoicesParam;
+    std::atomic<float>* mPolyphonyParam;
+    std::atomic<float>* mOversamplingParam;
+
+    // Shared by the grain banks of all voices
+    GrainPool mGrainPool;
+
+
+    // Workers for the "Parallel Voices" mode, nullptr on machines with a single core. They are started
+    // the first time the mode is on, until then the mode renders on the audio thread alone
+    std::unique_ptr<RenderThreadPool> mRenderThreadPool;
+    int mSamplesPerBlock = 512;
+
+    static constexpr double kSnapshotIntervalSeconds = 0.02;
+    GrainSnapshot mGrainSnapshot;
+    int mSnapshotIntervalSamples = 0;
+    int mSamplesSinceSnapshot = 0;
+
+    // Every sound that has been set and not freed yet. Never touched by the audio thread, the keymaps and
+    // the voices hold a reference to the sounds they play which keeps them from being freed
+    juce::CriticalSection mSoundLock;
+    juce::ReferenceCountedArray<MultigrainSound> mSounds;
+
+    // Set by setKeymap, taken by the audio thread
+    std::atomic<Keymap*> mPendingKeymap { nullptr };
+    // Keymap new notes play, audio thread only
+    Keymap* mCurrentKeymap = nullptr;
+
+    // Keymaps the audio thread replaced, slots are filled by the audio thread and emptied by freeRetiredSounds
+    static constexpr int kMaxNumRetiringKeymaps = 8;
+    std::array<std::atomic<Keymap*>, kMaxNumRetiringKeymaps> mRetiringKeymaps {};
 
-    static int const kNumVoices = 16;
+    // Reads the voices, so it has to stop before they are deleted
+    std::unique_ptr<SamplePrefetcher> mPrefetcher;
 
     JUCE_LEAK_DETECTOR(SynthAudioSource)
 };
\ No newline at end of file
@@ -0,0 +1,95 @@
+#include "./VoiceParameters.h"
+
+namespace
+{
+    constexpr double kRampLengthSeconds = .02;
+}
+
+VoiceParameters::VoiceParameters(juce::AudioProcessorValueTreeState& apvts)
+    : mGrainDurationParam(apvts.getRawParameterValue("Grain Duration")),
+      mNumGrainsParam(apvts.getRawParameterValue("Num Grains")),
+      mOnsetModeParam(apvts.getRawParameterValue("Onset Mode")),
+      mGrainDensityParam(apvts.getRawParameterValue("Grain Density")),
+      mOnsetJitterParam(apvts.getRawParameterValue("Onset Jitter")),
+      mGrainSpeedParam(apvts.getRawParameterValue("Grain Speed")),
+      mPositionRandomParam(apvts.getRawParameterValue("Position Random")),
+      mGrainDurationRandomParam(apvts.getRawParameterValue("Grain Duration Random")),
+      mGrainPitchIntervalParam(apvts.getRawParameterValue("Grain Pitch Interval")),
+      mGrainEnvelopeShapeParam(apvts.getRawParameterValue("Grain Envelope Shape")),
+      mInterpolationParam(apvts.getRawParameterValue("Interpolation")),
+      mPositionSnapParam(apvts.getRawParameterValue("Position Snap")),
+      mUnisonParam(apvts.getRawParameterValue("Unison")),
+      mUnisonDetuneParam(apvts.getRawParameterValue("Unison Detune")),
+      mUnisonWidthParam(apvts.getRawParameterValue("Unison Width"))
+{
+    reset();
+}
+
+void VoiceParameters::prepare(double sampleRate)
+{
+    mGrainDuration.reset(sampleRate, kRampLengthSeconds);
+    mGrainDensity.reset(sampleRate, kRampLengthSeconds);
+    mOnsetJitter.reset(sampleRate, kRampLengthSeconds);
+    mGrainSpeed.reset(sampleRate, kRampLengthSeconds);
+    mPositionRandom.reset(sampleRate, kRampLengthSeconds);
+    mGrainDurationRandom.reset(sampleRate, kRampLengthSeconds);
+    mUnisonDetune.reset(sampleRate, kRampLengthSeconds);
+    mUnisonWidth.reset(sampleRate, kRampLengthSeconds);
+    reset();
+}
+
+void VoiceParameters::reset()
+{
+    setTargets(true);
+    getNextSnapshot(0);
+}
+
+void VoiceParameters::update()
+{
+    setTargets(false);
+}
+
+const ParameterSnapshot& VoiceParameters::getNextSnapshot(int numSamples)
+{
+    jassert(numSamples <= kControlBlockSize);
+
+    mSnapshot.grainDuration = mGrainDuration.skip(numSamples);
+    mSnapshot.grainDensity = mGrainDensity.skip(numSamples);
+    mSnapshot.onsetJitter = mOnsetJitter.skip(numSamples);
+    mSnapshot.grainSpeed = mGrainSpeed.skip(numSamples);
+    mSnapshot.positionRandom = mPositionRandom.skip(numSamples);
+    mSnapshot.grainDurationRandom = mGrainDurationRandom.skip(numSamples);
+    mSnapshot.unisonDetune = mUnisonDetune.skip(numSamples);
+    mSnapshot.unisonWidth = mUnisonWidth.skip(numSamples);
+
+    return mSnapshot;
+}
+
+void VoiceParameters::setTargets(bool jump)
+{
+    auto setTarget = [jump](auto& smoothedValue, const std::atomic<float>* param)
+    {
+        if (jump)
+            smoothedValue.setCurrentAndTargetValue(param->load());
+        else
+            smoothedValue.setTargetValue(param->load());
+    };
+
+    setTarget(mGrainDuration, mGrainDurationParam);
+    setTarget(mGrainDensity, mGrainDensityParam);
+    setTarget(mOnsetJitter, mOnsetJitterParam);
+    setTarget(mGrainSpeed, mGrainSpeedParam);
+    setTarget(mPositionRandom, mPositionRandomParam);
+    setTarget(mGrainDurationRandom, mGrainDurationRandomParam);
+    setTarget(mUnisonDetune, mUnisonDetuneParam);
+    setTarget(mUnisonWidth, mUnisonWidthParam);
+
+    // Discrete parameters take effect at the next block
+    mSnapshot.numGrains = juce::jmax(1, (int) mNumGrainsParam->load());
+    mSnapshot.asynchronousOnsets = mOnsetModeParam->load() >= 0.5f;
+    mSnapshot.grainPitchInterval = (int) mGrainPitchIntervalParam->load();
+    mSnapshot.windowShape = (GrainWindows::Shape) juce::jlimit(0, GrainWindows::kNumShapes - 1, (int) mGrainEnvelopeShapeParam->load());
+    mSnapshot.unison = juce::jlimit(1, kMaxUnison, (int) mUnisonParam->load());
+    mSnapshot.interpolation = (GrainKernels::Interpolation) juce::jlimit(0, GrainKernels::kNumInterpolations - 1, (int) mInterpolationParam->load());
+    mSnapshot.positionSnap = (SampleIndex::Snap) juce::jlimit(0, SampleIndex::kNumSnaps - 1, (int) mPositionSnapParam->load());
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <juce_audio_processors/juce_audio_processors.h>
+
+#include "GrainKernels.h"
+#include "GrainWindows.h"
+#include "SampleIndex.h"
+
+// Plain values of the grain parameters for one control block
+struct ParameterSnapshot
+{
+    float grainDuration;
+    int numGrains;
+    bool asynchronousOnsets;
+    float grainDensity;
+    float onsetJitter;
+    float grainSpeed;
+    float positionRandom;
+    float grainDurationRandom;
+    int grainPitchInterval;
+    GrainWindows::Shape windowShape;
+    GrainKernels::Interpolation interpolation;
+    SampleIndex::Snap positionSnap;
+    int unison;
+    float unisonDetune;
+    float unisonWidth;
+};
+
+/**
+ * Reads the grain parameters of a voice from the APVTS once per block and ramps the continuous ones
+ * over kControlBlockSize sample steps, so automation does not jump between blocks.
+ */
+class VoiceParameters
+{
+public:
+    explicit VoiceParameters(juce::AudioProcessorValueTreeState& apvts);
+
+    void prepare(double sampleRate);
+
+    // Jumps to the current parameter values, a new note should not ramp from where the last one ended
+    void reset();
+
+    // Loads the parameter atomics, call once at the start of every block
+    void update();
+
+    // Advances the ramps by numSamples, which should be at most kControlBlockSize
+    const ParameterSnapshot& getNextSnapshot(int numSamples);
+
+    static constexpr int kControlBlockSize = 64;
+
+    // Upper limit of the "Unison" parameter
+    static constexpr int kMaxUnison = 8;
+
+private:
+    void setTargets(bool jump);
+
+    std::atomic<float>* mGrainDurationParam;
+    std::atomic<float>* mNumGrainsParam;
+    std::atomic<float>* mOnsetModeParam;
+    std::atomic<float>* mGrainDensityParam;
+    std::atomic<float>* mOnsetJitterParam;
+    std::atomic<float>* mGrainSpeedParam;
+    std::atomic<float>* mPositionRandomParam;
+    std::atomic<float>* mGrainDurationRandomParam;
+    std::atomic<float>* mGrainPitchIntervalParam;
+    std::atomic<float>* mGrainEnvelopeShapeParam;
+    std::atomic<float>* mInterpolationParam;
+    std::atomic<float>* mPositionSnapParam;
+    std::atomic<float>* mUnisonParam;
+    std::atomic<float>* mUnisonDetuneParam;
+    std::atomic<float>* mUnisonWidthParam;
+
+    // Duration and density are skewed parameters, ramping them by a constant factor sounds even
+    juce::SmoothedValue<float, juce::ValueSmoothingTypes::Multiplicative> mGrainDuration, mGrainDensity;
+    juce::SmoothedValue<float> mOnsetJitter, mGrainSpeed, mPositionRandom, mGrainDurationRandom, mUnisonDetune, mUnisonWidth;
+
+    ParameterSnapshot mSnapshot {};
+
+    JUCE_DECLARE_NON_COPYABLE(VoiceParameters)
+};
@@ -1,32 +1,5 @@
 #include "./DebugComponent.h"
 
-namespace
-{
-    size_t getNumGrains(const std::vector<Silo*>& silos)
-    {
-        auto grainCount = size_t{0};
-        for(const auto silo : silos) {
-            for(int i = 0; i < 8; i++) {
-                if ((*silo)[i]->isActive) grainCount += 1;
-            }
-        }
-
-        return grainCount;
-    }
-
-    size_t getNumActiveVoices(const juce::Synthesiser& synth)
-    {
-        auto numActiveVoices = size_t{0};
-        for (int i = 0; i < synth.getNumVoices(); i++)
-        {
-            auto voice = synth.getVoice(i);
-            numActiveVoices += voice->isVoiceActive() ? 1 : 0;
-        }
-
-        return numActiveVoices;
-    }
-}
-
 DebugComponent::DebugComponent(MultigrainAudioProcessor& processorRef)
     : processorRef(processorRef)
 {
@@ -57,13 +30,21 @@ juce::String DebugComponent::generateDebugText()
     debugText += "\n";
     debugText += "Voices: ";
     debugText += (int) mActiveVoices;
+    debugText += "\n";
+    debugText += "Stolen Grains: ";
+    debugText += mStolenGrainCount;
 
     return debugText;
 }
 
 void DebugComponent::timerCallback() 
 {
-    mGrainCount = getNumGrains(processorRef.getSynthAudioSource().getSilos());
-    mActiveVoices = getNumActiveVoices(processorRef.getSynthAudioSource().mSynth);
+    // Keeps the last counts if the audio thread was writing the snapshot the whole time
+    if (processorRef.getSynthAudioSource().getGrainSnapshot().read(mSnapshot))
+    {
+        mGrainCount = (size_t) mSnapshot.numGrains;
+        mActiveVoices = (size_t) mSnapshot.numActiveVoices;
+    }
+    mStolenGrainCount = processorRef.getSynthAudioSource().getGrainPool().getNumStolenGrains();
     repaint();
 }
\ No newline at end of file
@@ -19,5 +19,7 @@ private:
 
     size_t mGrainCount = 0;
     size_t mActiveVoices = 0;
+    int mStolenGrainCount = 0;
+    GrainSnapshot::Contents mSnapshot;
     MultigrainAudioProcessor& processorRef;
 };
\ No newline at end of file
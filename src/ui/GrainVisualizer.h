@@ -18,5 +18,8 @@ private:
     bool drawCircles = true;
     juce::Random random;
 
+    // The grains of the last timer callback, the editor never reads the voices themselves
+    GrainSnapshot::Contents mGrains;
+
     MultigrainAudioProcessor& processorRef;
 };
\ No newline at end of file
@@ -10,6 +10,7 @@ MainAudioThumbnailComponent::MainAudioThumbnailComponent(MultigrainAudioProcesso
       processorRef(processorRef)
 {
     audioThumbnail.addChangeListener(this);
+    processorRef.getSampleLoader().addChangeListener(this);
     setMouseCursor(juce::MouseCursor::PointingHandCursor);
 
     addAndMakeVisible(grainVisualizer);
@@ -18,6 +19,7 @@ MainAudioThumbnailComponent::MainAudioThumbnailComponent(MultigrainAudioProcesso
 MainAudioThumbnailComponent::~MainAudioThumbnailComponent()
 {
     audioThumbnail.removeChangeListener(this);
+    processorRef.getSampleLoader().removeChangeListener(this);
     audioThumbnail.setSource(nullptr); // No idea why this is needed but does not work otherwise
     previewAudioThumbnail.setSource(nullptr);
 }
@@ -28,6 +30,9 @@ void MainAudioThumbnailComponent::paint(juce::Graphics& g)
         paintIfNoFileLoaded(g, getLocalBounds());
     else
         paintIfFileLoaded(g, getLocalBounds());
+
+    if (processorRef.getSampleLoader().getState() == SampleLoader::State::loading)
+        paintLoadingProgress(g);
 }
 
 void MainAudioThumbnailComponent::resized()
@@ -48,6 +53,25 @@ void MainAudioThumbnailComponent::setSource(juce::InputSource* newSource)
 void MainAudioThumbnailComponent::changeListenerCallback(juce::ChangeBroadcaster* source)
 {
     if (source == &audioThumbnail) repaint();
+    else if (source == &processorRef.getSampleLoader()) sampleLoaderChanged();
+}
+
+void MainAudioThumbnailComponent::sampleLoaderChanged()
+{
+    auto& loader = processorRef.getSampleLoader();
+    if (loader.getState() == SampleLoader::State::finished && loader.getFile() != loadedFile)
+    {
+        loadedFile = loader.getFile();
+        previewAudioThumbnail.setSource(nullptr);
+        setSource(new juce::FileInputSource(loadedFile));
+    }
+    else if (loader.getState() == SampleLoader::State::failed)
+    {
+        // TODO: display error message here, the file could not be read
+        previewAudioThumbnail.setSource(nullptr);
+    }
+
+    repaint();
 }
 
 void MainAudioThumbnailComponent::mouseDown(const juce::MouseEvent& event)
@@ -133,6 +157,15 @@ void MainAudioThumbnailComponent::paintIfFileLoaded (juce::Graphics& g, const ju
     );
 }
 
+void MainAudioThumbnailComponent::paintLoadingProgress(juce::Graphics& g)
+{
+    auto bar = getLocalBounds().removeFromBottom(4);
+    g.setColour(juce::Colours::black.withAlpha(0.3f));
+    g.fillRect(bar);
+    g.setColour(juce::Colours::lightseagreen);
+    g.fillRect(bar.withWidth(juce::roundToInt((float) bar.getWidth() * processorRef.getSampleLoader().getProgress())));
+}
+
 void MainAudioThumbnailComponent::paintRandomPositionRegion(juce::Graphics& g)
 {
     auto bounds = getLocalBounds();
@@ -190,11 +223,12 @@ void MainAudioThumbnailComponent::fileDragExit (const juce::StringArray &files)
 
 void MainAudioThumbnailComponent::filesDropped(const juce::StringArray &files, int /*x*/, int /*y*/)
 {
+    // Several files at once are the zones of a multisample
+    juce::Array<juce::File> audioFiles;
     for (auto string : files)
-    {
-        auto file = juce::File(string);
-        setAudioSource(file);
-    }
+        audioFiles.add(juce::File(string));
+
+    setAudioSources(audioFiles);
 }
 
 void MainAudioThumbnailComponent::openFileChooser()
@@ -203,15 +237,16 @@ void MainAudioThumbnailComponent::openFileChooser()
                                                        juce::File{},
                                                        "*.wav");
     auto chooserFlags = juce::FileBrowserComponent::openMode
-                        | juce::FileBrowserComponent::canSelectFiles;
+                        | juce::FileBrowserComponent::canSelectFiles
+                        | juce::FileBrowserComponent::canSelectMultipleItems;
 
     chooser->launchAsync (chooserFlags, [this] (const juce::FileChooser& fc)
     {
-        auto file = fc.getResult();
+        auto files = fc.getResults();
 
-        if (file != juce::File{})
+        if (!files.isEmpty())
         {
-            setAudioSource(file);
+            setAudioSources(files);
         }
         else
         {
@@ -220,30 +255,11 @@ void MainAudioThumbnailComponent::openFileChooser()
     });
 }
 
-void MainAudioThumbnailComponent::setAudioSource(juce::File& file)
+void MainAudioThumbnailComponent::setAudioSources(const juce::Array<juce::File>& files)
 {
     setMouseCursor(juce::MouseCursor::IBeamCursor);
-    std::unique_ptr<juce::AudioFormatReader> reader (formatManager.createReaderFor(file));
-    if (reader.get() != nullptr)
-    {
-        std::cout << "Reader created!" << std::endl;
-        auto duration = (float) reader->lengthInSamples / reader->sampleRate;
-        if (duration < 10)
-        {
-            previewAudioThumbnail.setSource(nullptr);
-            processorRef.getSynthAudioSource().init(new MultigrainSound("Default", *reader, 0, 60, 10));
-            setSource(new juce::FileInputSource(file));
-        }
-        else
-        {
-            // TODO: handle the error that the file is 10 seconds or longer..
-        }
-    }
-    else
-    {
-        // TODO: display error message here
-        std::cout << "No reader created!" << std::endl;
-    }
+    // Decoding happens in the background, the waveform is swapped once the synth has the new samples
+    processorRef.getSampleLoader().loadFiles(files);
 }
 
 //==============================================================================
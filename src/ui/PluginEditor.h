@@ -42,9 +42,11 @@ private:
     void paintIfNoFileLoaded (juce::Graphics& g, const juce::Rectangle<int>& thumbnailBounds);
     void paintIfFileLoaded (juce::Graphics& g, const juce::Rectangle<int>& thumbnailBounds);
     void paintRandomPositionRegion(juce::Graphics& g);
+    void paintLoadingProgress(juce::Graphics& g);
+    void sampleLoaderChanged();
     void setCursorAtPoint(const juce::Point<int>& point);
     void openFileChooser();
-    void setAudioSource(juce::File& file);
+    void setAudioSources(const juce::Array<juce::File>& files);
 
     GrainVisualizer grainVisualizer;
     std::unique_ptr<juce::FileChooser> chooser;
@@ -52,6 +54,8 @@ private:
     juce::AudioThumbnailCache previewAudioThumbnailCache;
     juce::AudioThumbnail previewAudioThumbnail;
     juce::AudioFormatManager& formatManager;
+    // The file the waveform shows, set once the sample loader has finished with it
+    juce::File loadedFile;
     LookAndFeel lnf;
     MultigrainAudioProcessor& processorRef;
 };